@@ -0,0 +1,50 @@
+#ifndef __ADAPTIVE_PERIOD_H__
+#define __ADAPTIVE_PERIOD_H__
+
+/*
+ * Detection period of one camera driven by scene activity
+ *
+ * A new face brings the period down to min_period, tracked faces or fast
+ * tracker motion halve it, and an idle scene (nothing tracked, nothing new)
+ * lets it grow by half up to max_period. With min_period == max_period the
+ * period is fixed.
+ *
+ * The savings are counted against detecting every fixed_period frames. A due
+ * detection skipped for another reason (the motion gate) counts as done, so
+ * only the detections the period changes saved are counted here.
+ */
+class AdaptivePeriod {
+public:
+    AdaptivePeriod(int fixed_period, int min_period, int max_period);
+
+    int period() const { return period_; }
+
+    // a frame went by
+    void countFrame() { frames_++; }
+
+    /*
+     * result of a detection: faces tracked, faces seen for the first time and
+     * the largest tracker motion since the detection frame (in box widths)
+     */
+    void update(int tracked_faces, int new_faces, float motion, float detect_ms);
+
+    // a due detection was skipped by something else than the period
+    void countSkip() { skips_++; }
+
+    // detections skipped compared to the fixed period, and their estimated cost
+    long savedDetections() const;
+    float savedMs() const;
+    long detections() const { return detections_; }
+    float meanDetectMs() const { return detections_ > 0 ? detect_ms_ / detections_ : 0; }
+
+    // tracker motion (box widths between two detections) that counts as activity
+    static constexpr float HIGH_MOTION = 0.25f;
+
+private:
+    int fixed_period_, min_period_, max_period_;
+    int period_;
+    long frames_, detections_, skips_;
+    float detect_ms_;
+};
+
+#endif
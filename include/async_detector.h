@@ -0,0 +1,44 @@
+#ifndef __ASYNC_DETECTOR_H__
+#define __ASYNC_DETECTOR_H__
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mtcnn.h"
+
+/*
+ * Detection on a worker thread of its own
+ *
+ * The capture and tracking loop hands a frame over and keeps running, the
+ * faces come back through a future once the detector is done. The detector is
+ * used by the worker only, so its stats() are stable once the future is ready.
+ */
+class AsyncDetector {
+public:
+    explicit AsyncDetector(MTCNN& detector);
+    // waits for the submitted frame to be detected
+    ~AsyncDetector();
+
+    /*
+     * detect faces in a BGR frame, the frame is not copied and must stay
+     * unchanged until the result is ready; one frame at a time
+     */
+    std::future<std::vector<Bbox> > submit(const cv::Mat& frame, const DetectParams& params = DetectParams());
+
+private:
+    void run();
+
+    MTCNN& detector_;
+    std::mutex lock_;
+    std::condition_variable ready_;
+    cv::Mat frame_;
+    DetectParams params_;
+    std::promise<std::vector<Bbox> > result_;
+    bool pending_;
+    bool stop_;
+    std::thread worker_;
+};
+
+#endif
@@ -13,9 +13,35 @@ public:
     std::string ip;
     std::string username;
     std::string password;
-    int detection_period;
-
-    CameraConfig(){};
+    int detection_period; // frames between two detections
+    // bounds of the adaptive detection period, 0 for detection_period
+    int min_detection_period;
+    int max_detection_period;
+    // areas where faces come into view (doors), scanned on every detection
+    std::vector<cv::Rect> entry_zones;
+    // scan the whole frame every roi_full_scan detections and only the entry
+    // zones and tracked faces in between, 0 to always scan the whole frame
+    int roi_full_scan;
+    // areas that never hold real faces (screens, posters), no detection there
+    std::vector<std::vector<cv::Point> > exclusion_zones;
+    // {min, max} face side per horizontal band from the top, or the number of bands to learn them on
+    std::vector<std::pair<float, float> > face_sizes;
+    int face_size_bands;
+    // skip the pyramid scales that found no face in the last scale_window detections
+    // (0 scans every scale), all scales are scanned every scale_sweep detections
+    int scale_window;
+    int scale_sweep;
+    // width frames are downscaled to for detection (0 for the frame itself), with
+    // refine_landmarks the landmarks are refined on the frame
+    int detection_width;
+    bool refine_landmarks;
+
+    CameraConfig() : index(0), detection_period(DEFAULT_DETECTION_PERIOD), min_detection_period(0), max_detection_period(0), roi_full_scan(0), face_size_bands(0),
+                     scale_window(0), scale_sweep(DEFAULT_SCALE_SWEEP),
+                     detection_width(0), refine_landmarks(false) {};
+
+    static const int DEFAULT_DETECTION_PERIOD = 10;
+    static const int DEFAULT_SCALE_SWEEP = 10;
 
     // return ip, or index if no ip is given
     std::string identity() const;
@@ -0,0 +1,46 @@
+#ifndef __DETECTION_SCHEDULER_H__
+#define __DETECTION_SCHEDULER_H__
+
+#include <mutex>
+#include <vector>
+
+// how the detections were spread over time since start
+struct SchedulerStats {
+    long started;              // detections started
+    long deferred;             // frames a due detection waited for a free slot
+    int max_running;           // most detections running at once
+    std::vector<long> running; // running[k]: detections started while k others were running
+};
+
+/*
+ * Detection schedule shared by all cameras
+ *
+ * Each camera gets a phase offset within its detection period so the cameras
+ * take turns instead of detecting on the same frames, and at most
+ * max_concurrent detections run at a time: a camera whose detection is due
+ * while all slots are busy retries on its next frame.
+ */
+class DetectionScheduler {
+public:
+    // max_concurrent <= 0 does not limit the detections
+    DetectionScheduler(int cameras, int max_concurrent);
+
+    // first detection frame of camera (0 .. cameras - 1) for its period
+    int phase(int camera, int period) const;
+
+    // take a detection slot, false when max_concurrent detections are running
+    bool tryStart();
+    // give the slot of a finished detection back
+    void finish();
+
+    SchedulerStats stats();
+
+private:
+    int cameras_;
+    int max_concurrent_;
+    int running_;
+    std::mutex lock_;
+    SchedulerStats stats_;
+};
+
+#endif
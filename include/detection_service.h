@@ -0,0 +1,67 @@
+#ifndef __DETECTION_SERVICE_H__
+#define __DETECTION_SERVICE_H__
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mtcnn.h"
+
+// queue and batch metrics of a DetectionService since its creation
+struct DetectionServiceStats {
+    long requests;       // frames detected
+    long batches;        // batches the frames were detected in
+    int max_batch;       // largest batch
+    float queue_wait_ms; // total time the frames waited in the queue
+    float max_wait_ms;   // longest wait of a frame
+    float detect_ms;     // total detection time of the batches
+    long incomplete;     // frames cut short by their DetectParams deadline
+};
+
+/*
+ * Face detection shared by all camera threads
+ *
+ * Cameras submit frames to one queue. The worker takes every waiting frame (up
+ * to max_batch), runs PNet on each of them, then the RNet and ONet stages of
+ * all of them as one batch: the cores work on one large parallel sweep instead
+ * of N small detections competing for them at the same time.
+ */
+class DetectionService {
+public:
+    // options.num_threads is the thread count of the whole service
+    DetectionService(std::shared_ptr<const MTCNNModel> model, const MTCNNOptions& options, int max_batch = 8);
+    // waits for the submitted frames to be detected
+    ~DetectionService();
+
+    // detect faces in a BGR frame, the frame is copied
+    std::future<std::vector<Bbox> > submit(const cv::Mat& frame, const DetectParams& params = DetectParams());
+
+    DetectionServiceStats stats();
+
+private:
+    struct Request {
+        cv::Mat frame;
+        DetectParams params;
+        std::promise<std::vector<Bbox> > result;
+        struct timeval queued;
+    };
+
+    void run();
+    void detectBatch(std::vector<Request>& batch);
+
+    // one detection context per frame of a batch, all on the same model
+    std::vector<std::unique_ptr<MTCNN> > frames_;
+    std::vector<MTCNN*> stage_frames_;
+
+    std::mutex lock_;
+    std::condition_variable ready_;
+    std::deque<Request> queue_;
+    bool stop_;
+    DetectionServiceStats stats_;
+    std::thread worker_;
+};
+
+#endif
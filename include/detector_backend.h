@@ -0,0 +1,40 @@
+#ifndef __DETECTOR_BACKEND_H__
+#define __DETECTOR_BACKEND_H__
+
+#include "net.h"
+
+/*
+ * Inference runtime behind MTCNN
+ *
+ * Inputs are the normalized RGB planes of the image pyramid (ncnn::Mat, one
+ * channel per plane), so the pyramid, the candidate handling and the nms of
+ * MTCNN do not depend on the runtime that evaluates the networks.
+ */
+class DetectorBackend {
+public:
+    // per crop outputs of RNet/ONet: score, 4 box regression values, 10 landmarks (ONet only)
+    static const int STAGE_OUTPUT_SIZE = 15;
+    // the refinement stages
+    enum { STAGE_RNET = 0, STAGE_ONET = 1 };
+
+    virtual ~DetectorBackend() {};
+
+    virtual const char* name() const = 0;
+
+    // PNet over one image: face probability map (2 channels) and box regression map (4 channels)
+    virtual void runPNet(const ncnn::Mat& in, ncnn::Mat& score, ncnn::Mat& location) = 0;
+
+    // PNet over n independent images (tiles of a pyramid level), one after another by default
+    virtual void runPNetTiles(const ncnn::Mat* in, int n, ncnn::Mat* score, ncnn::Mat* location) {
+        for (int k = 0; k < n; k++)
+            runPNet(in[k], score[k], location[k]);
+    }
+
+    /*
+     * RNet (24x24) or ONet (48x48) over n crops packed 3 channels each into
+     * crops, STAGE_OUTPUT_SIZE outputs per crop are written to out
+     */
+    virtual void runStage(int stage, const ncnn::Mat& crops, int n, float* out) = 0;
+};
+
+#endif
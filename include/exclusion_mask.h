@@ -0,0 +1,44 @@
+#ifndef __EXCLUSION_MASK_H__
+#define __EXCLUSION_MASK_H__
+
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+class Bbox;
+
+/*
+ * Areas of a camera where faces are never real (TV screens, posters,
+ * reflections)
+ *
+ * PNet candidates whose center lies in one of the polygons are dropped before
+ * they reach RNet, so they cost no refinement, create no tracker and no saved
+ * face. The detector of the camera counts the drops of each polygon.
+ */
+class ExclusionMask {
+public:
+    // polygons in frame coordinates
+    explicit ExclusionMask(const std::vector<std::vector<cv::Point> >& polygons);
+
+    size_t size() const { return polygons_.size(); }
+
+    /*
+     * mark the existing boxes centered in a polygon as not existing, returns
+     * their number; factor_x and factor_y map the box coordinates to the frame
+     */
+    int suppress(std::vector<Bbox>& boxes, float factor_x = 1, float factor_y = 1);
+
+    // suppressed candidates per polygon since start
+    std::vector<long> counts();
+
+private:
+    // polygon holding (x, y), -1 for none
+    int find(float x, float y) const;
+
+    std::vector<std::vector<cv::Point> > polygons_;
+    std::vector<cv::Rect> bounds_;
+    std::mutex lock_;
+    std::vector<long> counts_;
+};
+
+#endif
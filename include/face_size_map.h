@@ -0,0 +1,63 @@
+#ifndef __FACE_SIZE_MAP_H__
+#define __FACE_SIZE_MAP_H__
+
+#include <vector>
+#include "mtcnn.h"
+
+/*
+ * Expected face sizes of one camera per horizontal band of the frame
+ *
+ * A ceiling camera sees large faces at the bottom of the frame and small ones
+ * at the top. The map splits the frame into equal bands, each with the range
+ * of face sides seen there; the detector uses it to skip the pyramid scales
+ * that cannot hold a face of the band.
+ *
+ * The ranges are either configured or learned from the detected faces: a band
+ * is known once min_samples faces were centered in it, until then it accepts
+ * any size. A learned map leaves every sweep_period-th detection unpruned so
+ * faces outside the learned ranges are still found and widen them.
+ */
+class FaceSizeMap {
+public:
+    // learned map of the given number of bands
+    explicit FaceSizeMap(int bands = 0, int min_samples = 20, int sweep_period = 10);
+    // configured map, sizes[i] = {min, max} of band i from the top
+    explicit FaceSizeMap(const std::vector<std::pair<float, float> >& sizes);
+
+    bool empty() const { return bands_.empty(); }
+    bool learning() const { return learning_; }
+
+    // learn from the faces detected on a frame of the given height
+    void update(const std::vector<Bbox>& faces, int frame_height);
+
+    /*
+     * the bands of the next detection on a frame of the given height, top to
+     * bottom, in DetectParams form; none on a sweep
+     */
+    void bands(int frame_height, std::vector<FaceSizeBand>& out);
+
+    // detections left unpruned to widen the learned ranges
+    long sweeps() const { return sweeps_; }
+
+    // bands whose sizes are known
+    int knownBands() const;
+
+    // margin on the learned sizes: a learned band accepts [min / margin, max * margin]
+    static constexpr float LEARN_MARGIN = 1.3f;
+
+private:
+    struct Band {
+        float min_size, max_size;
+        int samples;
+    };
+
+    bool known(const Band& band) const { return !learning_ || band.samples >= min_samples_; }
+
+    std::vector<Band> bands_;
+    bool learning_;
+    int min_samples_;
+    int sweep_period_;
+    long detections_, sweeps_;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef __IMAGE_PYRAMID_H__
+#define __IMAGE_PYRAMID_H__
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "net.h"
+
+/*
+ * Image pyramid shared by the detection stages of one frame
+ *
+ * Levels are ordered from fine to coarse: the image itself, its octaves
+ * (1/2, 1/4, ...) down to the first detection scale, then every detection
+ * scale. Each level is downsampled from the previous one, so the full
+ * resolution image is only read once.
+ *
+ * When built from BGR pixels the full resolution level is never converted to
+ * float: the first level is converted, normalized and resized in one pass and
+ * crops that need full resolution are taken from the pixels.
+ */
+class ImagePyramid {
+public:
+    ImagePyramid() : allocator_(0), mean_vals_(0), norm_vals_(0), width_(0), height_(0) {};
+
+    // allocator of the levels and crops, the default heap allocator when null
+    void setAllocator(ncnn::Allocator* allocator) { allocator_ = allocator; }
+
+    // build the levels of a normalized image for the given detection scales (descending)
+    void build(const ncnn::Mat& img, const std::vector<float>& scales);
+
+    // build the levels of a BGR frame, frame must outlive the pyramid
+    void build(const cv::Mat& frame, const std::vector<float>& scales, const float* mean_vals, const float* norm_vals);
+
+    // drop the levels and the reference to the source image
+    void clear();
+
+    inline int levels() const { return levels_.size(); }
+    inline const ncnn::Mat& level(int i) const { return levels_[i]; }
+    inline float scale(int i) const { return level_scales_[i]; }
+
+    // the level holding detection scale i
+    inline const ncnn::Mat& scaleLevel(int i) const { return levels_[scale_levels_[i]]; }
+
+    inline int width() const { return width_; }
+    inline int height() const { return height_; }
+
+    // coarsest level on which a box of side pixels still spans at least size pixels
+    int nearestLevel(float side, int size) const;
+
+    /*
+     * crop the box [x1, x2) x [y1, y2) (image coordinates) from the nearest
+     * level and resize it to size x size
+     */
+    void crop(int x1, int y1, int x2, int y2, int size, ncnn::Mat& out) const;
+
+private:
+    void addLevels(const std::vector<float>& scales);
+    void addLevel(float scale);
+
+    ncnn::Allocator *allocator_;
+
+    // BGR source of the full resolution level, empty when built from a float image
+    cv::Mat pixels_;
+    const float *mean_vals_;
+    const float *norm_vals_;
+
+    std::vector<ncnn::Mat> levels_;
+    std::vector<float> level_scales_;
+    std::vector<int> scale_levels_;
+    int width_, height_;
+};
+
+#endif
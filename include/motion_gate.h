@@ -0,0 +1,54 @@
+#ifndef __MOTION_GATE_H__
+#define __MOTION_GATE_H__
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// gate decisions of one camera since start
+struct MotionGateStats {
+    long checked; // frames compared with the previous detection frame
+    long passed;  // frames with motion, handed to the detector
+    long skipped; // frames without motion whose detection was skipped
+};
+
+/*
+ * Cheap front end of the detector
+ *
+ * A checked frame is shrunk to a small gray image and compared with the
+ * frame of the previous detection, so a detection deferred by the scheduler
+ * still sees the motion since the last one. When too few pixels changed the detection can be
+ * skipped; otherwise the bounding boxes of the changed areas tell PNet where
+ * to look.
+ */
+class MotionGate {
+public:
+    /*
+     * width: width of the compared images, threshold: gray level change of a
+     * moving pixel, min_area: fraction of moving pixels that counts as motion
+     */
+    MotionGate(int width = 160, int threshold = 20, float min_area = 0.001f);
+
+    /*
+     * true when the frame moved since the previous checked frame (or is the
+     * first one, which is scanned whole); regions: the moving areas in frame
+     * coordinates, empty without motion; can_skip: false when the detection
+     * runs anyway (e.g. to verify tracked faces), a still frame then does not
+     * count as skipped
+     */
+    bool check(const cv::Mat& frame, std::vector<cv::Rect>& regions, bool can_skip = true);
+
+    // the last checked frame was handed to the detector, later frames are compared with it
+    void commit();
+
+    const MotionGateStats& stats() const { return stats_; }
+
+private:
+    int width_;
+    int threshold_;
+    float min_area_;
+    cv::Mat small_, gray_, previous_, diff_;
+    std::vector<std::vector<cv::Point> > contours_;
+    MotionGateStats stats_;
+};
+
+#endif
@@ -1,15 +1,24 @@
 #ifndef __MTCNN_H__
 #define __MTCNN_H__
 
+#include <opencv2/opencv.hpp>
+#include <sys/time.h>
 #include <vector>
 #include "net.h"
+#include "detector_backend.h"
+#include "exclusion_mask.h"
+#include "image_pyramid.h"
+#include "mtcnn_model.h"
+#include "nms.h"
+#include "pool_allocator.h"
+#include "scale_history.h"
 
 using namespace std;
 using namespace cv;
 
 class Bbox {
 public:
-    Bbox(){};
+    Bbox() : level(-1) {};
 
     inline void scale(float factor_x, float factor_y) {
         this->x1 = round(this->x1 * factor_x);
@@ -32,37 +41,316 @@ public:
     bool exist;
     float ppoint[10];
     float regreCoord[4];
+    int level; // pyramid scale PNet found the box at
 };
 
-struct orderScore
-{
-    float score;
-    int oriOrder;
+/*
+ * Cells of a PNet output map that belong to one pyramid scale.
+ * Cell (c, r) looks at the 12x12 window whose top left corner is
+ * (2c + dx, 2r + dy) in the coordinates of that scale.
+ */
+struct ScoreWindow {
+    int col, row;
+    int cols, rows;
+    int dx, dy;
+};
+
+// timing and candidate counts of the last detect() call
+struct DetectStats {
+    float pyramid_ms;
+    float pnet_ms;
+    float rnet_ms;
+    float onet_ms;
+    int pnet_boxes; // candidates handed to RNet
+    int rnet_boxes; // candidates handed to ONet
+    int onet_boxes; // faces returned
+    int capped_boxes; // candidates dropped by the candidate limits
+    float pnet_area;  // fraction of the pyramid PNet scanned
+    int excluded_boxes; // PNet candidates dropped by the exclusion mask
+    int skipped_scales; // pyramid scales left out by the scale history
+    int coarse_regions; // regions around the coarse hits the finer scales scanned
+    /*
+     * share of the detection work done before the DetectParams deadline:
+     * scanned scales times evaluated RNet and ONet candidates, 1 when the
+     * detection ran to the end
+     */
+    float completeness;
+    bool deadline_hit;
+};
+
+// faces expected in the frame rows [y1, y2), sides in pixels
+struct FaceSizeBand {
+    int y1, y2;
+    float min_size, max_size;
+};
+
+// per frame detection settings
+struct DetectParams {
+    DetectParams() : detection_width(0), refine_landmarks(false), deadline_ms(0) {};
+
+    /*
+     * image regions that may contain new faces (e.g. where something moved),
+     * PNet only scans them with a margin of one detection window at every
+     * scale; empty scans the whole frame
+     */
+    std::vector<cv::Rect> regions;
+    // camera areas whose PNet candidates never reach RNet, none when null
+    std::shared_ptr<ExclusionMask> exclusions;
+    /*
+     * expected face sizes per horizontal band: each pyramid scale only scans
+     * the bands whose sizes it detects; empty scans every scale on every row
+     */
+    std::vector<FaceSizeBand> size_bands;
+    // scales that found the camera's faces, skips the unused ones; none when null
+    std::shared_ptr<ScaleHistory> scale_history;
+    /*
+     * width of the image the BGR frame is downscaled to before detection, 0
+     * for the frame itself; boxes and landmarks are mapped back to the frame,
+     * with refine_landmarks ONet reruns on the frame for exact landmarks
+     */
+    int detection_width;
+    bool refine_landmarks;
+    /*
+     * time budget of the detection, 0 for none. Scales run in the order of
+     * the faces they found (the cheap coarse ones first without a history)
+     * and candidates in the order of their scores; at the deadline the faces
+     * found so far are returned and DetectStats::completeness tells how much
+     * was left out.
+     */
+    float deadline_ms;
+};
+
+/*
+ * Bounds on the candidates that reach the refinement stages, 0 disables a
+ * bound. After the stage nms only the rnet_topk best PNet boxes go to RNet and
+ * the onet_topk best RNet boxes go to ONet; frame_budget bounds the RNet plus
+ * ONet crops of one frame, which bounds the worst case detection latency.
+ * RNet takes at most three quarters of the budget so ONet always gets the
+ * rest; a budget below 2 is rounded up to one crop per stage.
+ */
+struct CandidateLimits {
+    int rnet_topk;
+    int onet_topk;
+    int frame_budget;
+};
+
+// how many frames were cut by each candidate limit since the detector was created
+struct CandidateCapCounters {
+    long frames;
+    long rnet_topk;
+    long onet_topk;
+    long frame_budget;
+    long deadline;
+};
+
+
+/*
+ * Coarse to fine PNet: the coarse_levels coarsest scales are scanned as
+ * usual, every finer scale only around the cells of the coarser scales whose
+ * face probability passed pre_threshold (below the PNet threshold, so faces
+ * that only show at a finer scale still open a window). Every dense_every-th
+ * frame scans all scales densely, 0 never does.
+ */
+struct CoarseToFine {
+    CoarseToFine() : enable(false), pre_threshold(0.4f), coarse_levels(2), dense_every(0) {};
+
+    bool enable;
+    float pre_threshold;
+    int coarse_levels;
+    int dense_every;
 };
 
+// inference runtime of a detector
+enum DetectorBackendType {
+    BACKEND_NCNN,       // ncnn models: det1..det3 .param/.bin
+    BACKEND_OPENCV_DNN, // Caffe models through OpenCV dnn: det1..det3 .prototxt/.caffemodel
+};
+
+/*
+ * Settings of one detector. Every inference of the detector runs on at most
+ * num_threads cores, so several detectors (one per camera) can share the CPU
+ * without fighting over one OpenMP pool.
+ */
+struct MTCNNOptions {
+    MTCNNOptions() : backend(BACKEND_NCNN), transpose_input(true), num_threads(0), light_mode(true),
+                     pool_allocators(true), int8(false), batch_stages(false), pnet_mosaic(false), limits(), coarse_to_fine(), pnet_tile_size(0) {};
+
+    DetectorBackendType backend;
+    bool transpose_input; // OpenCV dnn only: the Caffe models expect transposed images
+
+    int num_threads;      // cores of one inference, 0 takes the OpenMP default of the creating thread
+    bool light_mode;      // release intermediate blobs as soon as they are consumed
+    bool pool_allocators; // blobs and workspace from the detector's pools instead of the heap
+    bool int8;            // load the quantized det1-int8 .. det3-int8 models written by the calibrate tool
+    bool batch_stages;    // see MTCNN::setBatchStages
+    bool pnet_mosaic;     // see MTCNN::setPNetMosaic
+    CandidateLimits limits;
+    CoarseToFine coarse_to_fine;
+    int pnet_tile_size;   // see MTCNN::setPNetTileSize
+};
 
 class MTCNN{
 public:
-    MTCNN();
-    MTCNN(const std::string& model_path);
-    void detect(ncnn::Mat& img_, std::vector<Bbox>& finalBbox);
+    explicit MTCNN(const MTCNNOptions& options = MTCNNOptions());
+    // load a model of its own from model_path, in the format of options.backend
+    MTCNN(const std::string& model_path, const MTCNNOptions& options = MTCNNOptions());
+    // share a loaded ncnn model with other detectors, options.backend and options.int8 are ignored
+    MTCNN(std::shared_ptr<const MTCNNModel> model, const MTCNNOptions& options = MTCNNOptions());
+    void detect(ncnn::Mat& img_, std::vector<Bbox>& finalBbox, const DetectParams& params = DetectParams());
+
+    /*
+     * detect faces in a BGR frame: color swap, normalization and resize are
+     * done in one pass per pyramid level, the full resolution frame is never
+     * converted to float
+     */
+    void detect(const cv::Mat& frame, std::vector<Bbox>& finalBbox, const DetectParams& params = DetectParams());
+
+    /*
+     * Batched stage mode: RNet/ONet crops are packed into one blob per stage
+     * and the stage is evaluated in a single parallel sweep instead of one
+     * extractor per box, one after another.
+     */
+    void setBatchStages(bool enable) { batch_stages_ = enable; }
+    /*
+     * Mosaic mode: all pyramid scales are tiled into one image and PNet runs
+     * once over it instead of once per scale. Frames with DetectParams
+     * regions, size bands or skipped scales and coarse to fine PNet are
+     * scanned per scale.
+     */
+    void setPNetMosaic(bool enable) { pnet_mosaic_ = enable; }
+    void setCandidateLimits(const CandidateLimits& limits) { limits_ = limits; }
+    void setCoarseToFine(const CoarseToFine& coarse_to_fine) { coarse_to_fine_ = coarse_to_fine; }
+    /*
+     * Tiled PNet: pyramid levels larger than size pixels in either direction
+     * are split into overlapping tiles of about size x size that run on the
+     * detector's cores in parallel, one single threaded inference per tile.
+     * 0 (or a single thread) runs PNet once per level on all cores.
+     */
+    void setPNetTileSize(int size) { pnet_tile_size_ = size; }
+    const DetectStats& stats() const { return stats_; }
+    const CandidateCapCounters& capCounters() const { return cap_counters_; }
+
+    /*
+     * number of buffers the blob and workspace pools took from the heap,
+     * stays constant once detection reaches steady state; allocations
+     * outside the ncnn pools are not counted
+     */
+    size_t heapAllocations();
+
+    // cores used by one inference
+    int numThreads() const { return num_threads_; }
 
 private:
-    void generateBbox(ncnn::Mat score, ncnn::Mat location, vector<Bbox>& boundingBox_, vector<orderScore>& bboxScore_, float scale);
-    void nms(vector<Bbox> &boundingBox_, std::vector<orderScore> &bboxScore_, const float overlap_threshold, string modelname="Union");
+    friend class DetectionService;
+    friend class PipelinedDetector;
+
+    enum { STAGE_RNET = DetectorBackend::STAGE_RNET, STAGE_ONET = DetectorBackend::STAGE_ONET };
+
+    // part of a pyramid level PNet runs on: input pixels, and the output cells it owns (from the top left)
+    struct PNetTile {
+        cv::Rect input;
+        int cols, rows;
+    };
+
+    // batch member of runStageBatch: box of a frame
+    struct StageCrop {
+        MTCNN *frame;
+        int box;
+    };
+
+    void setup(const MTCNNOptions& options);
+    void reserveBuffers();
+    void computeScales();
+    void beginFrame(const cv::Mat& frame);
+    void endFrame(const cv::Mat& frame, std::vector<Bbox>& finalBbox);
+    void refineLandmarks(const cv::Mat& frame, std::vector<Bbox>& finalBbox);
+    void buildPyramid(const cv::Mat& frame);
+    void detectPyramid(std::vector<Bbox>& finalBbox);
+    bool firstStage();
+    void evaluateStage(int stage);
+    bool acceptRNet();
+    void acceptONet(std::vector<Bbox>& finalBbox);
+    std::vector<Bbox>& stageInput(int stage) { return stage == STAGE_RNET ? firstBbox_ : secondBbox_; }
+    void generateBbox(ncnn::Mat score, ncnn::Mat location, vector<Bbox>& boundingBox_, float scale, const ScoreWindow& window);
+    void runPNet(const vector<float>& scales_);
+    void scaleOrder(bool coarse_first, std::vector<int>& order);
+    float elapsedMs() const;
+    int deadlineCandidates(float crop_ms, float share) const;
+    void capDeadline(vector<Bbox> &vecBbox, int stage, float share);
+    void updateCropCost(int stage, float stage_ms, int crops);
+    void scanWindows(int scale_index, const std::vector<cv::Rect>& regions, std::vector<cv::Rect>& windows);
+    void tileWindows(const std::vector<cv::Rect>& windows, std::vector<PNetTile>& tiles);
+    void markCoarseHits(const ncnn::Mat& score, const ScoreWindow& window, float scale);
+    void findCoarseRegions();
+    void scanRows(int scale_index, std::vector<cv::Range>& rows);
+    void runPNetMosaic(const vector<float>& scales_);
+    void appendScaleBbox(int level);
+    void nms(vector<Bbox> &boundingBox_, const float overlap_threshold, NmsMode mode=NMS_UNION);
+    int capCandidates(vector<Bbox> &vecBbox, int topk, int budget, long &topk_counter);
     void refineAndSquareBbox(vector<Bbox> &vecBbox, const int &height, const int &width);
+    void runStage(int stage);
+    static void runStageBatch(MTCNN* const* frames, int count, int stage);
 
-    ncnn::Net pnet_, rnet_, onet_;
-    ncnn::Mat img;
+    std::unique_ptr<DetectorBackend> backend_;
+    // declared before any ncnn::Mat member, the pools must outlive their buffers
+    CountingPoolAllocator blob_allocator_, workspace_allocator_;
+    ImagePyramid pyramid_;
+    std::vector<cv::Rect> mosaic_layout_;
+    DetectParams params_;
+    std::vector<cv::Rect> scan_windows_;
+    std::vector<cv::Range> scan_rows_;
+    std::vector<PNetTile> pnet_tiles_;
+    std::vector<ncnn::Mat> tile_in_, tile_score_, tile_location_;
+    std::vector<char> scale_active_; // scales PNet scans on this frame, empty for all
+    // coarse to fine PNet: hits of the coarser scales on a small mask, and their regions
+    cv::Mat coarse_mask_, coarse_contour_mask_;
+    std::vector<std::vector<cv::Point> > coarse_contours_;
+    std::vector<cv::Rect> coarse_regions_;
+    long coarse_frames_ = 0;
+    // deadline of DetectParams: start of the frame, scale order, running cost of one RNet/ONet crop
+    struct timeval frame_tv_;
+    std::vector<int> scale_order_;
+    float crop_ms_[2] = {0, 0};
+    // share of the deadline PNet may take, the rest is left to RNet and ONet
+    static constexpr float PNET_DEADLINE_SHARE = 0.6f;
+    static const int COARSE_MASK_WIDTH = 160;
+    cv::Mat detection_frame_; // the downscaled frame
+    float detection_factor_x_ = 1; // frame pixels per detection pixel, horizontally
+    float detection_factor_y_ = 1; // and vertically
 
     const float nms_threshold[3] = {0.5, 0.7, 0.7};
     const float threshold[3] = {0.7, 0.6, 0.8};
     const float mean_vals[3] = {127.5, 127.5, 127.5};
     const float norm_vals[3] = {0.0078125, 0.0078125, 0.0078125};
     std::vector<Bbox> firstBbox_, secondBbox_,thirdBbox_;
-    
-    std::vector<orderScore> firstOrderScore_, secondBboxScore_, thirdBboxScore_;
+    std::vector<Bbox> scaleBbox_;
+
+    NmsEngine nms_;
+    BoxArray nms_boxes_;
+    std::vector<int> nms_index_, nms_keep_;
     int img_w, img_h;
+    std::vector<float> scales_;
+
+    // per candidate network outputs of the running stage: score, 4 regression values, 10 landmarks
+    static const int STAGE_OUTPUT_SIZE = DetectorBackend::STAGE_OUTPUT_SIZE;
+    std::vector<float> stage_out_;
+    std::vector<int> stage_index_;
+    std::vector<StageCrop> stage_crops_;
+    std::vector<float> stage_batch_out_;
+    int budget_;
+    struct timeval stage_tv_;
+    static const int RESERVED_CANDIDATES = 1024;
+
+    int num_threads_ = 1;
+    bool light_mode_ = true;
+    ncnn::Allocator *blob_pool_ = 0, *workspace_pool_ = 0;
+    bool batch_stages_ = false;
+    bool pnet_mosaic_ = false;
+    CandidateLimits limits_ = CandidateLimits();
+    CoarseToFine coarse_to_fine_ = CoarseToFine();
+    int pnet_tile_size_ = 0;
+    CandidateCapCounters cap_counters_ = CandidateCapCounters();
+    DetectStats stats_ = DetectStats();
 };
 
 
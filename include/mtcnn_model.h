@@ -0,0 +1,45 @@
+#ifndef __MTCNN_MODEL_H__
+#define __MTCNN_MODEL_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "net.h"
+
+/*
+ * The three MTCNN networks, loaded once and shared read-only by any number of
+ * detectors (one per camera thread).
+ *
+ * The .bin weight files are memory-mapped and ncnn reads the weights in place,
+ * so N detectors cost one copy of the weights, backed by the page cache.
+ */
+class MTCNNModel {
+public:
+    ~MTCNNModel();
+
+    /*
+     * load det1..det3 (det1-int8..det3-int8 when int8) from model_path, null on
+     * failure; mapped=false reads the weights into a private heap copy instead
+     */
+    static std::shared_ptr<const MTCNNModel> load(const std::string& model_path, bool int8=false, bool mapped=true);
+
+    ncnn::Net pnet, rnet, onet;
+
+private:
+    MTCNNModel() {};
+    MTCNNModel(const MTCNNModel&);
+    MTCNNModel& operator=(const MTCNNModel&);
+
+    bool loadNet(ncnn::Net& net, const std::string& param_file, const std::string& bin_file, bool mapped);
+    // the weights copied to the heap, the way each detector loaded them before sharing
+    bool readNet(ncnn::Net& net, const std::string& bin_file);
+
+    struct Mapping {
+        void *addr;
+        size_t length;
+    };
+    // released after the nets, which point into them
+    std::vector<Mapping> mappings_;
+};
+
+#endif
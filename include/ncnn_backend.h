@@ -0,0 +1,35 @@
+#ifndef __NCNN_BACKEND_H__
+#define __NCNN_BACKEND_H__
+
+#include <memory>
+#include "detector_backend.h"
+#include "mtcnn_model.h"
+
+/*
+ * ncnn runtime on a shared MTCNNModel
+ *
+ * A single input runs on num_threads cores; a batch of crops or PNet tiles
+ * runs one single threaded extractor per input, num_threads inputs at a time.
+ */
+class NcnnBackend : public DetectorBackend {
+public:
+    NcnnBackend(std::shared_ptr<const MTCNNModel> model, int num_threads, bool light_mode,
+                ncnn::Allocator* blob_allocator, ncnn::Allocator* workspace_allocator);
+
+    virtual const char* name() const { return "ncnn"; }
+    virtual void runPNet(const ncnn::Mat& in, ncnn::Mat& score, ncnn::Mat& location);
+    virtual void runPNetTiles(const ncnn::Mat* in, int n, ncnn::Mat* score, ncnn::Mat* location);
+    virtual void runStage(int stage, const ncnn::Mat& crops, int n, float* out);
+
+private:
+    ncnn::Extractor newExtractor(const ncnn::Net& net, int num_threads);
+    void runCrop(int stage, const ncnn::Mat& in, int num_threads, float* out);
+    void runPNet(const ncnn::Mat& in, int num_threads, ncnn::Mat& score, ncnn::Mat& location);
+
+    std::shared_ptr<const MTCNNModel> model_;
+    int num_threads_;
+    bool light_mode_;
+    ncnn::Allocator *blob_allocator_, *workspace_allocator_;
+};
+
+#endif
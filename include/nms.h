@@ -0,0 +1,55 @@
+#ifndef __NMS_H__
+#define __NMS_H__
+
+#include <vector>
+
+enum NmsMode {
+    NMS_UNION,  // intersection over union
+    NMS_MIN     // intersection over the smaller box
+};
+
+/*
+ * Candidate boxes in struct-of-arrays form, so the overlap of one box
+ * against all the others reads contiguous memory.
+ */
+struct BoxArray {
+    std::vector<float> x1, y1, x2, y2, area, score;
+
+    inline size_t size() const { return score.size(); }
+
+    inline void clear() {
+        x1.clear(); y1.clear(); x2.clear(); y2.clear(); area.clear(); score.clear();
+    }
+
+    inline void reserve(size_t n) {
+        x1.reserve(n); y1.reserve(n); x2.reserve(n); y2.reserve(n); area.reserve(n); score.reserve(n);
+    }
+
+    inline void push_back(float bx1, float by1, float bx2, float by2, float barea, float bscore) {
+        x1.push_back(bx1); y1.push_back(by1); x2.push_back(bx2); y2.push_back(by2);
+        area.push_back(barea); score.push_back(bscore);
+    }
+};
+
+/*
+ * Non maximum suppression
+ *
+ * boxes are sorted once by score, then each kept box is compared against the
+ * remaining ones with a vectorized IOU and the survivors are compacted in place.
+ * The engine keeps its buffers between calls.
+ */
+class NmsEngine {
+public:
+    /*
+     * keep receives the indices (into boxes) of the surviving boxes, highest score first.
+     * A box is suppressed when its overlap with a kept box is greater than overlap_threshold.
+     */
+    void run(const BoxArray& boxes, float overlap_threshold, NmsMode mode, std::vector<int>& keep);
+
+private:
+    std::vector<int> order_;
+    BoxArray sorted_;
+    std::vector<float> iou_;
+};
+
+#endif
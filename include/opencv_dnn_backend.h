@@ -0,0 +1,37 @@
+#ifndef __OPENCV_DNN_BACKEND_H__
+#define __OPENCV_DNN_BACKEND_H__
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include "detector_backend.h"
+
+/*
+ * OpenCV dnn runtime on the Caffe models (det1..det3 .prototxt/.caffemodel)
+ *
+ * The original Caffe MTCNN models were trained from Matlab on transposed
+ * images: with transpose_input the inputs are transposed before and the PNet
+ * maps after inference. A batch of crops runs as one forward pass. OpenCV
+ * picks its own thread count, the num_threads option does not apply.
+ */
+class OpenCVDnnBackend : public DetectorBackend {
+public:
+    OpenCVDnnBackend(const std::string& model_path, bool transpose_input);
+
+    // false when a network failed to load
+    bool loaded() const;
+
+    virtual const char* name() const { return "opencv-dnn"; }
+    virtual void runPNet(const ncnn::Mat& in, ncnn::Mat& score, ncnn::Mat& location);
+    virtual void runStage(int stage, const ncnn::Mat& crops, int n, float* out);
+
+private:
+    void toBlob(const ncnn::Mat& in, int n, cv::Mat& blob) const;
+    void fromMap(const cv::Mat& map, ncnn::Mat& out) const;
+
+    cv::dnn::Net pnet_, rnet_, onet_;
+    bool transpose_;
+    cv::Mat blob_;
+    std::vector<cv::Mat> outs_;
+};
+
+#endif
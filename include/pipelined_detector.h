@@ -0,0 +1,88 @@
+#ifndef __PIPELINED_DETECTOR_H__
+#define __PIPELINED_DETECTOR_H__
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+#include "mtcnn.h"
+
+// pipeline activity since start
+struct PipelineStats {
+    long frames;         // frames detected
+    float busy_ms[3];    // time each stage (PNet, RNet, ONet) worked on a frame
+    float elapsed_ms;    // time since the first frame was submitted
+    float occupancy(int stage) const { return elapsed_ms > 0 ? busy_ms[stage] / elapsed_ms : 0; }
+};
+
+/*
+ * Detection as a three stage pipeline for back to back frames (video replay,
+ * short detection periods)
+ *
+ * PNet, RNet and ONet run on worker threads of their own connected by bounded
+ * queues, so PNet of frame t+1 runs while RNet/ONet work on frame t. Each frame
+ * in flight has a detection context of its own on the shared model; every
+ * stage takes its frames in submission order, so the results come back in
+ * that order. submit blocks while the pipeline is full.
+ */
+class PipelinedDetector {
+public:
+    // options.num_threads is the thread count of each stage
+    PipelinedDetector(std::shared_ptr<const MTCNNModel> model, const MTCNNOptions& options, int queue_size = 2);
+    // waits for the submitted frames to be detected
+    ~PipelinedDetector();
+
+    // detect faces in a BGR frame, the frame is copied
+    std::future<std::vector<Bbox> > submit(const cv::Mat& frame, const DetectParams& params = DetectParams());
+
+    PipelineStats stats();
+
+private:
+    enum { STAGE_PNET, STAGE_RNET, STAGE_ONET, STAGES };
+
+    struct Job {
+        MTCNN *detector;
+        cv::Mat frame;
+        DetectParams params;
+        std::promise<std::vector<Bbox> > result;
+        bool candidates; // false once a stage found nothing left to refine
+    };
+
+    // FIFO of at most capacity jobs, pop returns null once closed and empty
+    class StageQueue {
+    public:
+        explicit StageQueue(size_t capacity) : capacity_(capacity), closed_(false) {};
+        void push(Job* job);
+        Job* pop();
+        void close();
+
+    private:
+        size_t capacity_;
+        bool closed_;
+        std::mutex lock_;
+        std::condition_variable changed_;
+        std::deque<Job*> jobs_;
+    };
+
+    void run(int stage);
+    void process(int stage, Job* job);
+    void countBusy(int stage, const struct timeval& start);
+
+    // detection contexts, a free one is taken by submit and given back after ONet
+    std::vector<std::unique_ptr<MTCNN> > detectors_;
+    std::unique_ptr<StageQueue> free_;
+    // input of each stage
+    std::unique_ptr<StageQueue> queues_[STAGES];
+    std::thread workers_[STAGES];
+
+    std::mutex stats_lock_;
+    PipelineStats stats_;
+    struct timeval start_;
+    bool started_;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef __POOL_ALLOCATOR_H__
+#define __POOL_ALLOCATOR_H__
+
+#include <mutex>
+#include <unordered_set>
+#include "net.h"
+
+/*
+ * ncnn pool allocator that counts the buffers it had to take from the heap
+ *
+ * A buffer handed out for the first time is a heap allocation, a buffer
+ * reused from the pool comes back with a pointer seen before. Once a detector
+ * reaches steady state the count stops growing.
+ */
+class CountingPoolAllocator : public ncnn::Allocator {
+public:
+    CountingPoolAllocator() : heap_allocations_(0) {};
+
+    virtual void* fastMalloc(size_t size);
+    virtual void fastFree(void* ptr);
+
+    // number of buffers taken from the heap since construction or clear()
+    size_t heapAllocations();
+
+    // release the pooled buffers, every buffer must have been returned
+    void clear();
+
+private:
+    ncnn::PoolAllocator pool_;
+    std::mutex lock_;
+    std::unordered_set<void*> seen_;
+    size_t heap_allocations_;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef __SCALE_HISTORY_H__
+#define __SCALE_HISTORY_H__
+
+#include <mutex>
+#include <vector>
+
+class Bbox;
+
+// pyramid scale usage of one camera since start
+struct ScaleHistoryStats {
+    long detections;          // detections that consulted the history
+    long sweeps;              // detections that scanned every scale
+    std::vector<long> faces;  // faces[i]: final detections found at scale i
+    std::vector<long> skipped; // skipped[i]: detections that skipped scale i
+};
+
+/*
+ * Which pyramid scales find the faces of one camera
+ *
+ * A camera at a fixed height sees faces of a few sizes only. The history
+ * counts the scale every final detection came from; a scale that found no
+ * face (and whose neighbours found none) during the last window detections
+ * is skipped. Every sweep_period-th detection scans every scale so faces of a
+ * new size are still found, and the first window detections all do.
+ */
+class ScaleHistory {
+public:
+    ScaleHistory(int window, int sweep_period);
+
+    /*
+     * start a detection over the given number of scales: active[i] tells
+     * whether scale i is scanned, returns false for a full sweep
+     */
+    bool begin(int scales, std::vector<char>& active);
+
+    // count the scales of the faces found by the detection
+    void record(const std::vector<Bbox>& faces);
+
+    ScaleHistoryStats stats();
+
+private:
+    int window_;
+    int sweep_period_;
+    std::mutex lock_;
+    std::vector<long> last_face_; // detection of the latest face per scale, -1 for none
+    ScaleHistoryStats stats_;
+};
+
+#endif
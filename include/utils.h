@@ -21,4 +21,7 @@ void prepare_output_folder(const CameraConfig &camera, string &output_folder);
 
 void saveFace(const cv::Mat &frame, const Bbox &box, long faceId, string outputFolder);
 
+// resident memory of this process in kB (VmRSS), -1 when unknown
+long get_resident_memory_kb();
+
 #endif
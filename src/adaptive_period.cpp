@@ -0,0 +1,31 @@
+#include <algorithm>
+#include "adaptive_period.h"
+
+constexpr float AdaptivePeriod::HIGH_MOTION;
+
+AdaptivePeriod::AdaptivePeriod(int fixed_period, int min_period, int max_period)
+    : fixed_period_(std::max(1, fixed_period)), frames_(0), detections_(0), skips_(0), detect_ms_(0) {
+    min_period_ = std::max(1, min_period);
+    max_period_ = std::max(min_period_, max_period);
+    period_ = std::min(std::max(fixed_period_, min_period_), max_period_);
+}
+
+void AdaptivePeriod::update(int tracked_faces, int new_faces, float motion, float detect_ms) {
+    detections_++;
+    detect_ms_ += detect_ms;
+
+    if (new_faces > 0)
+        period_ = min_period_;
+    else if (tracked_faces > 0 || motion > HIGH_MOTION)
+        period_ = std::max(min_period_, period_ / 2);
+    else
+        period_ = std::min(max_period_, period_ + std::max(1, period_ / 2));
+}
+
+long AdaptivePeriod::savedDetections() const {
+    return frames_ / fixed_period_ - detections_ - skips_;
+}
+
+float AdaptivePeriod::savedMs() const {
+    return detections_ > 0 ? savedDetections() * detect_ms_ / detections_ : 0;
+}
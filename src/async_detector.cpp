@@ -0,0 +1,53 @@
+#include "async_detector.h"
+
+AsyncDetector::AsyncDetector(MTCNN& detector)
+    : detector_(detector), pending_(false), stop_(false) {
+    worker_ = std::thread(&AsyncDetector::run, this);
+}
+
+AsyncDetector::~AsyncDetector() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stop_ = true;
+    }
+    ready_.notify_one();
+    worker_.join();
+}
+
+std::future<std::vector<Bbox> > AsyncDetector::submit(const cv::Mat& frame, const DetectParams& params) {
+    std::future<std::vector<Bbox> > result;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        frame_ = frame;
+        params_ = params;
+        result_ = std::promise<std::vector<Bbox> >();
+        result = result_.get_future();
+        pending_ = true;
+    }
+    ready_.notify_one();
+    return result;
+}
+
+void AsyncDetector::run() {
+    while (true) {
+        cv::Mat frame;
+        DetectParams params;
+        std::promise<std::vector<Bbox> > result;
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            ready_.wait(guard, [this] { return stop_ || pending_; });
+            if (!pending_)
+                return;
+            frame = frame_;
+            params = std::move(params_);
+            params_ = DetectParams();
+            frame_ = cv::Mat();
+            result = std::move(result_);
+            pending_ = false;
+        }
+
+        std::vector<Bbox> faces;
+        detector_.detect(frame, faces, params);
+        result.set_value(faces);
+    }
+}
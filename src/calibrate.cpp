@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "image_pyramid.h"
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * int8 calibration of the MTCNN models
+ *
+ * Runs the fp32 det1/det2/det3 over a folder of sample frames, picks the
+ * threshold of every convolution input by KL divergence, quantizes the
+ * convolution weights per output channel and writes det{1,2,3}-int8.param/.bin.
+ * InnerProduct, PReLU and the other layers stay fp32.
+ * Ends with a per stage speed and accuracy comparison of both model sets.
+ */
+
+static const float mean_vals[3] = {127.5, 127.5, 127.5};
+static const float norm_vals[3] = {0.0078125, 0.0078125, 0.0078125};
+
+static const int HISTOGRAM_BINS = 2048;
+static const int QUANTIZE_BINS = 128;
+static const uint32_t INT8_WEIGHT_TAG = 0x000D4B38;
+
+struct Layer {
+    string type;
+    string name;
+    vector<string> bottoms;
+    vector<string> tops;
+    map<int, string> params;
+    string line;
+
+    int param(int key, int default_value) const {
+        map<int, string>::const_iterator it = params.find(key);
+        return it == params.end() ? default_value : atoi(it->second.c_str());
+    }
+};
+
+struct Activation {
+    string blob;
+    float max_abs;
+    vector<float> histogram;
+    float scale;
+};
+
+struct Network {
+    string name;       // det1, det2, det3
+    int input_size;    // crop size of RNet/ONet, 0 for PNet
+    vector<string> header;
+    vector<Layer> layers;
+    ncnn::Net net;
+    vector<ncnn::Mat> samples;
+    map<string, Activation> activations; // by convolution name
+};
+
+static bool load_param(const string &path, Network &network) {
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        cerr << "failed to open " << path << endl;
+        return false;
+    }
+
+    char buffer[4096];
+    int line_number = 0;
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        string line(buffer);
+        line.erase(line.find_last_not_of("\r\n") + 1);
+        if (line_number++ < 2) {
+            // magic number, then layer and blob count
+            network.header.push_back(line);
+            continue;
+        }
+
+        istringstream iss(line);
+        Layer layer;
+        int bottom_count = 0, top_count = 0;
+        iss >> layer.type >> layer.name >> bottom_count >> top_count;
+        layer.bottoms.resize(bottom_count);
+        for (int i = 0; i < bottom_count; i++) iss >> layer.bottoms[i];
+        layer.tops.resize(top_count);
+        for (int i = 0; i < top_count; i++) iss >> layer.tops[i];
+
+        string token;
+        while (iss >> token) {
+            size_t eq = token.find('=');
+            if (eq != string::npos) {
+                layer.params[atoi(token.substr(0, eq).c_str())] = token.substr(eq + 1);
+            }
+        }
+        layer.line = line;
+        network.layers.push_back(layer);
+    }
+    fclose(fp);
+    return true;
+}
+
+// run the fp32 network over its samples, first for the range then for the histogram of every convolution input
+static void collect(Network &network, bool histogram) {
+    for (size_t i = 0; i < network.samples.size(); i++) {
+        ncnn::Extractor ex = network.net.create_extractor();
+        // intermediate blobs are extracted one after another
+        ex.set_light_mode(false);
+        ex.input("data", network.samples[i]);
+
+        for (map<string, Activation>::iterator it = network.activations.begin(); it != network.activations.end(); it++) {
+            Activation &act = it->second;
+            ncnn::Mat blob;
+            ex.extract(act.blob.c_str(), blob);
+
+            float bin_width = act.max_abs / HISTOGRAM_BINS;
+            for (int q = 0; q < blob.c; q++) {
+                const float *ptr = blob.channel(q);
+                for (int k = 0; k < blob.w * blob.h; k++) {
+                    float v = fabs(ptr[k]);
+                    if (!histogram) {
+                        act.max_abs = max(act.max_abs, v);
+                    } else if (v > 0 && bin_width > 0) {
+                        int bin = min((int)(v / bin_width), HISTOGRAM_BINS - 1);
+                        act.histogram[bin] += 1.f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * threshold of the activation histogram that minimizes the KL divergence
+ * between the clipped distribution and its 128 level quantization
+ */
+static float kl_threshold(const Activation &act) {
+    const vector<float> &hist = act.histogram;
+    float bin_width = act.max_abs / HISTOGRAM_BINS;
+
+    int best = HISTOGRAM_BINS;
+    float best_divergence = 1e30f;
+    for (int i = QUANTIZE_BINS; i <= HISTOGRAM_BINS; i++) {
+        // reference distribution, outliers folded into the last bin
+        vector<float> p(hist.begin(), hist.begin() + i);
+        for (int k = i; k < HISTOGRAM_BINS; k++) p[i - 1] += hist[k];
+
+        // quantized distribution expanded back to i bins
+        vector<float> q(i, 0.f);
+        float merge = (float)i / QUANTIZE_BINS;
+        for (int j = 0; j < QUANTIZE_BINS; j++) {
+            int start = j * merge;
+            int end = (j == QUANTIZE_BINS - 1) ? i : (int)((j + 1) * merge);
+            float sum = 0;
+            int nonzero = 0;
+            for (int k = start; k < end; k++) {
+                sum += hist[k];
+                if (hist[k] != 0) nonzero++;
+            }
+            for (int k = start; k < end; k++) {
+                q[k] = (nonzero > 0 && hist[k] != 0) ? sum / nonzero : 0;
+            }
+        }
+
+        float p_sum = 0, q_sum = 0;
+        for (int k = 0; k < i; k++) { p_sum += p[k]; q_sum += q[k]; }
+        if (p_sum == 0 || q_sum == 0) continue;
+
+        float divergence = 0;
+        for (int k = 0; k < i; k++) {
+            float pk = p[k] / p_sum;
+            float qk = q[k] / q_sum;
+            if (pk == 0) continue;
+            divergence += pk * log(pk / max(qk, 1e-10f));
+        }
+        if (divergence < best_divergence) {
+            best_divergence = divergence;
+            best = i;
+        }
+    }
+    return (best + 0.5f) * bin_width;
+}
+
+static bool read_floats(FILE *fp, vector<float> &data, size_t n) {
+    data.resize(n);
+    return n == 0 || fread(&data[0], sizeof(float), n, fp) == n;
+}
+
+static void write_floats(FILE *fp, const vector<float> &data) {
+    if (!data.empty()) fwrite(&data[0], sizeof(float), data.size(), fp);
+}
+
+/*
+ * write the int8 model: convolution weights quantized per output channel
+ * behind the int8 weight tag, followed by the fp32 bias, the weight scales
+ * and the scale of the bottom blob (int8_scale_term=2 in the param)
+ */
+static bool write_int8(const string &model_path, const string &output_path, Network &network) {
+    string bin_path = model_path + "/" + network.name + ".bin";
+    FILE *in = fopen(bin_path.c_str(), "rb");
+    if (!in) {
+        cerr << "failed to open " << bin_path << endl;
+        return false;
+    }
+    string out_bin_path = output_path + "/" + network.name + "-int8.bin";
+    string out_param_path = output_path + "/" + network.name + "-int8.param";
+    FILE *bin = fopen(out_bin_path.c_str(), "wb");
+    FILE *param = fopen(out_param_path.c_str(), "w");
+    if (!bin || !param) {
+        cerr << "failed to write " << out_bin_path << endl;
+        fclose(in);
+        if (bin) fclose(bin);
+        if (param) fclose(param);
+        return false;
+    }
+
+    for (size_t i = 0; i < network.header.size(); i++) {
+        fprintf(param, "%s\n", network.header[i].c_str());
+    }
+
+    bool ok = true;
+    for (size_t l = 0; l < network.layers.size() && ok; l++) {
+        const Layer &layer = network.layers[l];
+        vector<float> weights, bias;
+        uint32_t flag = 0;
+        string line = layer.line;
+
+        if (layer.type == "Convolution" || layer.type == "InnerProduct") {
+            int num_output = layer.param(0, 0);
+            int bias_term = layer.param(layer.type == "Convolution" ? 5 : 1, 0);
+            int weight_data_size = layer.param(layer.type == "Convolution" ? 6 : 2, 0);
+
+            ok = fread(&flag, sizeof(flag), 1, in) == 1 && flag == 0
+                && read_floats(in, weights, weight_data_size)
+                && read_floats(in, bias, bias_term ? num_output : 0);
+            if (!ok) {
+                cerr << network.name << ": unsupported weights of " << layer.name << endl;
+                break;
+            }
+
+            map<string, Activation>::iterator act = network.activations.find(layer.name);
+            if (layer.type == "Convolution" && act != network.activations.end() && act->second.scale > 0) {
+                int per_output = weight_data_size / num_output;
+                vector<float> weight_scales(num_output);
+                vector<signed char> quantized(weight_data_size);
+                for (int o = 0; o < num_output; o++) {
+                    float max_abs = 0;
+                    for (int k = 0; k < per_output; k++) max_abs = max(max_abs, fabs(weights[o * per_output + k]));
+                    weight_scales[o] = max_abs > 0 ? 127.f / max_abs : 1.f;
+                    for (int k = 0; k < per_output; k++) {
+                        int v = round(weights[o * per_output + k] * weight_scales[o]);
+                        quantized[o * per_output + k] = max(-127, min(127, v));
+                    }
+                }
+
+                fwrite(&INT8_WEIGHT_TAG, sizeof(uint32_t), 1, bin);
+                fwrite(&quantized[0], 1, quantized.size(), bin);
+                static const char padding[4] = {0, 0, 0, 0};
+                fwrite(padding, 1, (4 - quantized.size() % 4) % 4, bin);
+                write_floats(bin, bias);
+                write_floats(bin, weight_scales);
+                fwrite(&act->second.scale, sizeof(float), 1, bin);
+                line += " 8=2";
+            } else {
+                fwrite(&flag, sizeof(flag), 1, bin);
+                write_floats(bin, weights);
+                write_floats(bin, bias);
+            }
+        } else if (layer.type == "PReLU") {
+            ok = read_floats(in, weights, layer.param(0, 0));
+            write_floats(bin, weights);
+        }
+        fprintf(param, "%s\n", line.c_str());
+    }
+
+    if (ok && fgetc(in) != EOF) {
+        cerr << network.name << ": unexpected data at the end of " << bin_path << endl;
+        ok = false;
+    }
+    fclose(in);
+    fclose(bin);
+    fclose(param);
+    if (ok) {
+        cout << "write " << out_param_path << " and " << out_bin_path << endl;
+    }
+    return ok;
+}
+
+// pyramid scales of MTCNN::detect
+static vector<float> detection_scales(int width, int height) {
+    vector<float> scales;
+    float minl = min(width, height);
+    float m = 12.f / 80;
+    minl *= m;
+    while (minl > 12) {
+        scales.push_back(m);
+        m *= 0.709;
+        minl *= 0.709;
+    }
+    return scales;
+}
+
+static float iou(const Bbox &a, const Bbox &b) {
+    float w = min(a.x2, b.x2) - max(a.x1, b.x1);
+    float h = min(a.y2, b.y2) - max(a.y1, b.y1);
+    if (w <= 0 || h <= 0) return 0;
+    float inter = w * h;
+    return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+/*
+ * calibration samples: every PNet pyramid level, and for RNet/ONet crops
+ * jittered around the fp32 detections plus random background crops
+ */
+static void prepare_samples(const vector<cv::Mat> &frames, MTCNN &mm, vector<Network> &networks) {
+    for (size_t f = 0; f < frames.size(); f++) {
+        const cv::Mat &frame = frames[f];
+        vector<float> scales = detection_scales(frame.cols, frame.rows);
+        ImagePyramid pyramid;
+        pyramid.build(frame, scales, mean_vals, norm_vals);
+        for (size_t i = 0; i < scales.size(); i++) {
+            networks[0].samples.push_back(pyramid.scaleLevel(i).clone());
+        }
+
+        vector<Bbox> faces;
+        mm.detect(frame, faces);
+        for (int k = 0; k < 8; k++) {
+            int x1, y1, side;
+            if (!faces.empty() && k < 6) {
+                const Bbox &face = faces[rand() % faces.size()];
+                int face_side = max(face.x2 - face.x1, face.y2 - face.y1);
+                side = face_side * (80 + rand() % 45) / 100;
+                x1 = face.x1 + (rand() % (face_side / 2 + 1)) - face_side / 4;
+                y1 = face.y1 + (rand() % (face_side / 2 + 1)) - face_side / 4;
+            } else {
+                side = 40 + rand() % max(1, min(frame.cols, frame.rows) / 3);
+                x1 = rand() % max(1, frame.cols - side);
+                y1 = rand() % max(1, frame.rows - side);
+            }
+            for (int n = 1; n < 3; n++) {
+                ncnn::Mat crop;
+                pyramid.crop(x1, y1, x1 + side, y1 + side, networks[n].input_size, crop);
+                networks[n].samples.push_back(crop);
+            }
+        }
+    }
+}
+
+static void compare(const string &model_path, const string &output_path, const vector<cv::Mat> &frames) {
+    MTCNN fp32(model_path);
+    MTCNNOptions int8_options;
+    int8_options.int8 = true;
+    MTCNN int8(output_path, int8_options);
+
+    float fp32_ms[3] = {0, 0, 0}, int8_ms[3] = {0, 0, 0};
+    int detections = 0, int8_detections = 0, lost = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        vector<Bbox> expected, actual;
+        fp32.detect(frames[f], expected);
+        int8.detect(frames[f], actual);
+
+        const DetectStats &a = fp32.stats(), &b = int8.stats();
+        fp32_ms[0] += a.pnet_ms; fp32_ms[1] += a.rnet_ms; fp32_ms[2] += a.onet_ms;
+        int8_ms[0] += b.pnet_ms; int8_ms[1] += b.rnet_ms; int8_ms[2] += b.onet_ms;
+
+        for (size_t i = 0; i < actual.size(); i++) {
+            if (actual[i].exist) int8_detections++;
+        }
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (!expected[i].exist) continue;
+            detections++;
+            bool found = false;
+            for (size_t j = 0; j < actual.size() && !found; j++) {
+                found = actual[j].exist && iou(expected[i], actual[j]) > 0.5;
+            }
+            if (!found) lost++;
+        }
+    }
+
+    const char *stages[3] = {"pnet", "rnet", "onet"};
+    int n = max((size_t)1, frames.size());
+    cout << "comparison on " << frames.size() << " frames" << endl;
+    for (int s = 0; s < 3; s++) {
+        cout << "\t" << stages[s] << ": fp32 " << fp32_ms[s] / n << " ms, int8 " << int8_ms[s] / n
+             << " ms, speedup " << (int8_ms[s] > 0 ? fp32_ms[s] / int8_ms[s] : 0) << "x" << endl;
+    }
+    cout << "\tdetections: fp32 " << detections << ", int8 " << int8_detections << ", lost "
+         << lost << " (" << (detections ? 100.f * lost / detections : 0) << "%)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    const cv::String keys =
+        "{help h usage ? |            | print this message              }"
+        "{model          |models/ncnn | path to the fp32 mtcnn model    }"
+        "{frames         |            | folder of calibration frames    }"
+        "{output         |            | output folder, model by default }"
+        "{max_frames     |200         | frames used for calibration     }"
+    ;
+
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about("mtcnn int8 calibration");
+    if (parser.has("help") || !parser.has("frames")) {
+        parser.printMessage();
+        return 0;
+    }
+
+    string model_path = parser.get<cv::String>("model");
+    string frames_path = parser.get<cv::String>("frames");
+    string output_path = parser.has("output") ? parser.get<cv::String>("output") : model_path;
+    int max_frames = parser.get<int>("max_frames");
+    if (!parser.check()) {
+        parser.printErrors();
+        return 0;
+    }
+
+    vector<string> files;
+    if (trave_dir(frames_path, files) != 0) {
+        return 1;
+    }
+    sort(files.begin(), files.end());
+    vector<cv::Mat> frames;
+    for (size_t i = 0; i < files.size() && (int)frames.size() < max_frames; i++) {
+        cv::Mat frame = cv::imread(files[i], CV_LOAD_IMAGE_COLOR);
+        if (!frame.empty()) frames.push_back(frame);
+    }
+    if (frames.empty()) {
+        cerr << "no frames in " << frames_path << endl;
+        return 1;
+    }
+    cout << "calibrate with " << frames.size() << " frames" << endl;
+
+    vector<Network> networks(3);
+    const int input_sizes[3] = {0, 24, 48};
+    for (int n = 0; n < 3; n++) {
+        Network &network = networks[n];
+        network.name = "det" + to_string(n + 1);
+        network.input_size = input_sizes[n];
+        string param_path = model_path + "/" + network.name + ".param";
+        if (!load_param(param_path, network)) {
+            return 1;
+        }
+        network.net.load_param(param_path.c_str());
+        network.net.load_model((model_path + "/" + network.name + ".bin").c_str());
+
+        for (size_t l = 0; l < network.layers.size(); l++) {
+            if (network.layers[l].type == "Convolution") {
+                Activation act;
+                act.blob = network.layers[l].bottoms[0];
+                act.max_abs = 0;
+                act.histogram.assign(HISTOGRAM_BINS, 0.f);
+                act.scale = 0;
+                network.activations[network.layers[l].name] = act;
+            }
+        }
+    }
+
+    srand(2018);
+    MTCNN mm(model_path);
+    prepare_samples(frames, mm, networks);
+
+    for (int n = 0; n < 3; n++) {
+        Network &network = networks[n];
+        collect(network, false);
+        collect(network, true);
+        for (map<string, Activation>::iterator it = network.activations.begin(); it != network.activations.end(); it++) {
+            Activation &act = it->second;
+            if (act.max_abs > 0) {
+                float threshold = kl_threshold(act);
+                act.scale = 127.f / threshold;
+                cout << network.name << " " << it->first << ": max " << act.max_abs << ", threshold " << threshold
+                     << ", scale " << act.scale << endl;
+            }
+        }
+        network.samples.clear();
+        if (!write_int8(model_path, output_path, network)) {
+            return 1;
+        }
+    }
+
+    compare(model_path, output_path, frames);
+    return 0;
+}
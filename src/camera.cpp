@@ -1,4 +1,5 @@
 #include <camera.h>
+#include <algorithm>
 #include <vector>
 #include "utils.h"
 
@@ -25,6 +26,24 @@ void CameraConfig::updateAttribute(const std::string content) {
             this->username = values[1];
         } else if (values[0] == "password") {
             this->password = values[1];
+        } else if (values[0] == "detection_period") {
+            this->detection_period = std::max(1, atoi(values[1].c_str()));
+        } else if (values[0] == "min_detection_period") {
+            this->min_detection_period = std::max(0, atoi(values[1].c_str()));
+        } else if (values[0] == "max_detection_period") {
+            this->max_detection_period = std::max(0, atoi(values[1].c_str()));
+        } else if (values[0] == "roi_full_scan") {
+            this->roi_full_scan = std::max(0, atoi(values[1].c_str()));
+        } else if (values[0] == "face_size_bands") {
+            this->face_size_bands = std::max(0, atoi(values[1].c_str()));
+        } else if (values[0] == "scale_window") {
+            this->scale_window = std::max(0, atoi(values[1].c_str()));
+        } else if (values[0] == "scale_sweep") {
+            this->scale_sweep = std::max(1, atoi(values[1].c_str()));
+        } else if (values[0] == "detection_width") {
+            this->detection_width = std::max(0, atoi(values[1].c_str()));
+        } else if (values[0] == "refine_landmarks") {
+            this->refine_landmarks = values[1] == "true" || values[1] == "1";
         }
     }
 }
@@ -70,6 +89,64 @@ std::vector<CameraConfig> LoadCameraConfig(std::string config_path) {
                         if (ip) camera.ip = *ip;
                         auto index = table->get_as<int>("index");
                         if (index) camera.index = *index;
+                        auto period = table->get_as<int>("detection_period");
+                        if (period) camera.detection_period = std::max(1, *period);
+                        auto min_period = table->get_as<int>("min_detection_period");
+                        if (min_period) camera.min_detection_period = std::max(0, *min_period);
+                        auto max_period = table->get_as<int>("max_detection_period");
+                        if (max_period) camera.max_detection_period = std::max(0, *max_period);
+                        auto full_scan = table->get_as<int>("roi_full_scan");
+                        if (full_scan) camera.roi_full_scan = std::max(0, *full_scan);
+                        // entry_zones = [[x, y, width, height], ...]
+                        auto zones = table->get_array_of<cpptoml::array>("entry_zones");
+                        if (zones) {
+                            for (const auto &zone : *zones) {
+                                auto values = zone->get_array_of<int64_t>();
+                                if (values && values->size() == 4)
+                                    camera.entry_zones.push_back(cv::Rect((*values)[0], (*values)[1], (*values)[2], (*values)[3]));
+                                else
+                                    LOG(WARNING) << "ignore entry zone of camera " << camera.identity() << ", expected [x, y, width, height]";
+                            }
+                        }
+                        // exclusion_zones = [[x1, y1, x2, y2, x3, y3, ...], ...]
+                        auto exclusions = table->get_array_of<cpptoml::array>("exclusion_zones");
+                        if (exclusions) {
+                            for (const auto &zone : *exclusions) {
+                                auto values = zone->get_array_of<int64_t>();
+                                if (!values || values->size() < 6 || values->size() % 2) {
+                                    LOG(WARNING) << "ignore exclusion zone of camera " << camera.identity() << ", expected [x1, y1, x2, y2, x3, y3, ...]";
+                                    continue;
+                                }
+                                std::vector<cv::Point> polygon;
+                                for (size_t k = 0; k < values->size(); k += 2)
+                                    polygon.push_back(cv::Point((*values)[k], (*values)[k + 1]));
+                                camera.exclusion_zones.push_back(polygon);
+                            }
+                        }
+                        auto scale_window = table->get_as<int>("scale_window");
+                        if (scale_window) camera.scale_window = std::max(0, *scale_window);
+                        auto scale_sweep = table->get_as<int>("scale_sweep");
+                        if (scale_sweep) camera.scale_sweep = std::max(1, *scale_sweep);
+                        auto detection_width = table->get_as<int>("detection_width");
+                        if (detection_width) camera.detection_width = std::max(0, *detection_width);
+                        auto refine = table->get_as<bool>("refine_landmarks");
+                        if (refine) camera.refine_landmarks = *refine;
+                        auto size_bands = table->get_as<int>("face_size_bands");
+                        if (size_bands) camera.face_size_bands = std::max(0, *size_bands);
+                        // face_sizes = [[min, max], ...], one band per entry from the top of the frame
+                        auto sizes = table->get_array_of<cpptoml::array>("face_sizes");
+                        if (sizes) {
+                            for (const auto &band : *sizes) {
+                                auto values = band->get_array_of<int64_t>();
+                                if (values && values->size() == 2) {
+                                    camera.face_sizes.push_back(std::make_pair((float)(*values)[0], (float)(*values)[1]));
+                                } else {
+                                    LOG(WARNING) << "ignore face sizes of camera " << camera.identity() << ", expected one [min, max] per band";
+                                    camera.face_sizes.clear();
+                                    break;
+                                }
+                            }
+                        }
 
                         auto meta = table->get_as<std::string>("Meta");
                         if (meta) {
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include "detection_scheduler.h"
+
+DetectionScheduler::DetectionScheduler(int cameras, int max_concurrent)
+    : cameras_(std::max(1, cameras)), max_concurrent_(max_concurrent), running_(0), stats_() {
+    stats_.running.resize(cameras_, 0);
+}
+
+int DetectionScheduler::phase(int camera, int period) const {
+    // spread the cameras evenly over one period
+    return (camera % cameras_) * period / cameras_;
+}
+
+bool DetectionScheduler::tryStart() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (max_concurrent_ > 0 && running_ >= max_concurrent_) {
+        stats_.deferred++;
+        return false;
+    }
+
+    if (running_ >= (int)stats_.running.size())
+        stats_.running.resize(running_ + 1, 0);
+    stats_.running[running_]++;
+    running_++;
+    stats_.started++;
+    stats_.max_running = std::max(stats_.max_running, running_);
+    return true;
+}
+
+void DetectionScheduler::finish() {
+    std::lock_guard<std::mutex> guard(lock_);
+    running_--;
+}
+
+SchedulerStats DetectionScheduler::stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include "detection_service.h"
+#include "time_utils.h"
+
+DetectionService::DetectionService(std::shared_ptr<const MTCNNModel> model, const MTCNNOptions& options, int max_batch)
+    : stop_(false), stats_() {
+    // crops of all frames are always packed into one batch per stage
+    MTCNNOptions frame_options = options;
+    frame_options.batch_stages = true;
+    for (int i = 0; i < std::max(1, max_batch); i++)
+        frames_.push_back(std::unique_ptr<MTCNN>(new MTCNN(model, frame_options)));
+    stage_frames_.reserve(frames_.size());
+
+    worker_ = std::thread(&DetectionService::run, this);
+}
+
+DetectionService::~DetectionService() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stop_ = true;
+    }
+    ready_.notify_one();
+    worker_.join();
+}
+
+std::future<std::vector<Bbox> > DetectionService::submit(const cv::Mat& frame, const DetectParams& params) {
+    Request request;
+    // the capture loop reuses its frame buffer
+    request.frame = frame.clone();
+    request.params = params;
+    gettimeofday(&request.queued, NULL);
+    std::future<std::vector<Bbox> > result = request.result.get_future();
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        queue_.push_back(std::move(request));
+    }
+    ready_.notify_one();
+    return result;
+}
+
+DetectionServiceStats DetectionService::stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
+
+void DetectionService::run() {
+    std::vector<Request> batch;
+    batch.reserve(frames_.size());
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            ready_.wait(guard, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+
+            // every frame that arrived while the previous batch ran
+            while (!queue_.empty() && batch.size() < frames_.size()) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+
+        detectBatch(batch);
+        batch.clear();
+    }
+}
+
+void DetectionService::detectBatch(std::vector<Request>& batch) {
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    float wait_ms = 0, max_wait_ms = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        float wait = getElapse(&batch[i].queued, &tv1);
+        wait_ms += wait;
+        max_wait_ms = std::max(max_wait_ms, wait);
+    }
+
+    // PNet per frame, the frames that still have candidates go on together
+    stage_frames_.clear();
+    for (size_t i = 0; i < batch.size(); i++) {
+        MTCNN *frame = frames_[i].get();
+        frame->params_ = batch[i].params;
+        frame->beginFrame(batch[i].frame);
+        if (frame->firstStage())
+            stage_frames_.push_back(frame);
+    }
+
+    if (!stage_frames_.empty()) {
+        MTCNN::runStageBatch(&stage_frames_[0], stage_frames_.size(), MTCNN::STAGE_RNET);
+
+        size_t remaining = 0;
+        for (size_t i = 0; i < stage_frames_.size(); i++) {
+            if (stage_frames_[i]->acceptRNet())
+                stage_frames_[remaining++] = stage_frames_[i];
+        }
+        stage_frames_.resize(remaining);
+    }
+
+    if (!stage_frames_.empty())
+        MTCNN::runStageBatch(&stage_frames_[0], stage_frames_.size(), MTCNN::STAGE_ONET);
+
+    long incomplete = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        MTCNN *frame = frames_[i].get();
+        std::vector<Bbox> faces;
+        if (std::find(stage_frames_.begin(), stage_frames_.end(), frame) != stage_frames_.end())
+            frame->acceptONet(faces);
+        frame->endFrame(batch[i].frame, faces);
+        incomplete += frame->stats().deadline_hit;
+        batch[i].result.set_value(faces);
+    }
+
+    gettimeofday(&tv2, NULL);
+    std::lock_guard<std::mutex> guard(lock_);
+    stats_.requests += batch.size();
+    stats_.batches++;
+    stats_.max_batch = std::max(stats_.max_batch, (int)batch.size());
+    stats_.queue_wait_ms += wait_ms;
+    stats_.max_wait_ms = std::max(stats_.max_wait_ms, max_wait_ms);
+    stats_.detect_ms += getElapse(&tv1, &tv2);
+    stats_.incomplete += incomplete;
+}
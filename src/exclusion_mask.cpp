@@ -0,0 +1,44 @@
+#include "exclusion_mask.h"
+#include "mtcnn.h"
+
+ExclusionMask::ExclusionMask(const std::vector<std::vector<cv::Point> >& polygons)
+    : polygons_(polygons), counts_(polygons.size(), 0) {
+    for (size_t i = 0; i < polygons_.size(); i++)
+        bounds_.push_back(cv::boundingRect(polygons_[i]));
+}
+
+int ExclusionMask::find(float x, float y) const {
+    for (size_t i = 0; i < polygons_.size(); i++) {
+        const cv::Rect& r = bounds_[i];
+        if (x < r.x || y < r.y || x >= r.x + r.width || y >= r.y + r.height)
+            continue;
+        if (cv::pointPolygonTest(polygons_[i], cv::Point2f(x, y), false) >= 0)
+            return i;
+    }
+    return -1;
+}
+
+int ExclusionMask::suppress(std::vector<Bbox>& boxes, float factor_x, float factor_y) {
+    if (polygons_.empty())
+        return 0;
+
+    int suppressed = 0;
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < boxes.size(); i++) {
+        Bbox& box = boxes[i];
+        if (!box.exist)
+            continue;
+        int polygon = find((box.x1 + box.x2) * 0.5f * factor_x, (box.y1 + box.y2) * 0.5f * factor_y);
+        if (polygon >= 0) {
+            box.exist = false;
+            counts_[polygon]++;
+            suppressed++;
+        }
+    }
+    return suppressed;
+}
+
+std::vector<long> ExclusionMask::counts() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return counts_;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cfloat>
+#include "face_size_map.h"
+
+constexpr float FaceSizeMap::LEARN_MARGIN;
+
+FaceSizeMap::FaceSizeMap(int bands, int min_samples, int sweep_period)
+    : bands_(std::max(0, bands)), learning_(true), min_samples_(std::max(1, min_samples)),
+      sweep_period_(std::max(1, sweep_period)), detections_(0), sweeps_(0) {
+    for (size_t i = 0; i < bands_.size(); i++) {
+        bands_[i].min_size = FLT_MAX;
+        bands_[i].max_size = 0;
+        bands_[i].samples = 0;
+    }
+}
+
+FaceSizeMap::FaceSizeMap(const std::vector<std::pair<float, float> >& sizes)
+    : bands_(sizes.size()), learning_(false), min_samples_(1), sweep_period_(1), detections_(0), sweeps_(0) {
+    for (size_t i = 0; i < sizes.size(); i++) {
+        bands_[i].min_size = sizes[i].first;
+        bands_[i].max_size = sizes[i].second;
+        bands_[i].samples = 0;
+    }
+}
+
+void FaceSizeMap::update(const std::vector<Bbox>& faces, int frame_height) {
+    if (!learning_ || bands_.empty() || frame_height <= 0)
+        return;
+
+    for (size_t i = 0; i < faces.size(); i++) {
+        const Bbox& face = faces[i];
+        if (!face.exist)
+            continue;
+        int center = (face.y1 + face.y2) / 2;
+        int k = std::min(std::max(0, center * (int)bands_.size() / frame_height), (int)bands_.size() - 1);
+        float side = std::max(face.x2 - face.x1, face.y2 - face.y1);
+        Band& band = bands_[k];
+        band.min_size = std::min(band.min_size, side);
+        band.max_size = std::max(band.max_size, side);
+        band.samples++;
+    }
+}
+
+void FaceSizeMap::bands(int frame_height, std::vector<FaceSizeBand>& out) {
+    out.clear();
+    if (learning_ && knownBands() > 0 && detections_++ % sweep_period_ == 0) {
+        sweeps_++;
+        return;
+    }
+    const int n = bands_.size();
+    for (int i = 0; i < n; i++) {
+        const Band& band = bands_[i];
+        FaceSizeBand b;
+        b.y1 = i * frame_height / n;
+        b.y2 = (i + 1) * frame_height / n;
+        if (!known(band)) {
+            b.min_size = 0;
+            b.max_size = FLT_MAX;
+        } else if (learning_) {
+            b.min_size = band.min_size / LEARN_MARGIN;
+            b.max_size = band.max_size * LEARN_MARGIN;
+        } else {
+            b.min_size = band.min_size;
+            b.max_size = band.max_size;
+        }
+        out.push_back(b);
+    }
+}
+
+int FaceSizeMap::knownBands() const {
+    int count = 0;
+    for (size_t i = 0; i < bands_.size(); i++) {
+        if (known(bands_[i]))
+            count++;
+    }
+    return count;
+}
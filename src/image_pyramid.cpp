@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <math.h>
+#include "image_pyramid.h"
+
+void ImagePyramid::build(const ncnn::Mat& img, const std::vector<float>& scales) {
+    clear();
+
+    width_ = img.w;
+    height_ = img.h;
+    levels_.push_back(img);
+    level_scales_.push_back(1.f);
+
+    addLevels(scales);
+}
+
+void ImagePyramid::build(const cv::Mat& frame, const std::vector<float>& scales, const float* mean_vals, const float* norm_vals) {
+    clear();
+
+    pixels_ = frame.isContinuous() ? frame : frame.clone();
+    mean_vals_ = mean_vals;
+    norm_vals_ = norm_vals;
+
+    width_ = frame.cols;
+    height_ = frame.rows;
+    // placeholder for the full resolution level, see crop()
+    levels_.push_back(ncnn::Mat());
+    level_scales_.push_back(1.f);
+
+    addLevels(scales);
+}
+
+void ImagePyramid::clear() {
+    levels_.clear();
+    level_scales_.clear();
+    scale_levels_.clear();
+    pixels_.release();
+}
+
+void ImagePyramid::addLevels(const std::vector<float>& scales) {
+    if (scales.empty()) {
+        return;
+    }
+
+    // octaves keep the crops of the later stages sharp without reading the full image
+    float octave = 0.5f;
+    while (octave > scales[0]) {
+        addLevel(octave);
+        octave *= 0.5f;
+    }
+
+    for (size_t i = 0; i < scales.size(); i++) {
+        if (scales[i] >= 1.f) {
+            if (levels_[0].empty()) {
+                // a detection scale needs the full resolution level after all
+                levels_[0] = ncnn::Mat::from_pixels(pixels_.data, ncnn::Mat::PIXEL_BGR2RGB, width_, height_, allocator_);
+                levels_[0].substract_mean_normalize(mean_vals_, norm_vals_);
+            }
+            scale_levels_.push_back(0);
+        } else {
+            addLevel(scales[i]);
+            scale_levels_.push_back(levels_.size() - 1);
+        }
+    }
+}
+
+/*
+ * downsample the current coarsest level, the level size is computed from the
+ * image size so it matches a direct resize of the image
+ */
+void ImagePyramid::addLevel(float scale) {
+    int w = (int)ceil(width_ * scale);
+    int h = (int)ceil(height_ * scale);
+
+    ncnn::Mat dst;
+    if (levels_.size() == 1 && !pixels_.empty()) {
+        // color swap, resize and normalization straight from the pixels
+        dst = ncnn::Mat::from_pixels_resize(pixels_.data, ncnn::Mat::PIXEL_BGR2RGB, width_, height_, w, h, allocator_);
+        dst.substract_mean_normalize(mean_vals_, norm_vals_);
+    } else {
+        resize_bilinear(levels_.back(), dst, w, h, allocator_);
+    }
+    levels_.push_back(dst);
+    level_scales_.push_back(scale);
+}
+
+int ImagePyramid::nearestLevel(float side, int size) const {
+    for (int i = levels_.size() - 1; i > 0; i--) {
+        if (side * level_scales_[i] >= size) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void ImagePyramid::crop(int x1, int y1, int x2, int y2, int size, ncnn::Mat& out) const {
+    int l = nearestLevel(std::max(x2 - x1, y2 - y1), size);
+    if (l == 0 && !pixels_.empty()) {
+        int px1 = std::min(std::max(x1, 0), width_ - 1);
+        int py1 = std::min(std::max(y1, 0), height_ - 1);
+        int px2 = std::min(std::max(x2, px1 + 1), width_);
+        int py2 = std::min(std::max(y2, py1 + 1), height_);
+
+        // continuous copy of the box pixels, staged in a pool buffer
+        ncnn::Mat staging((px2 - px1) * 3, py2 - py1, (size_t)1u, allocator_);
+        cv::Mat roi(py2 - py1, px2 - px1, CV_8UC3, staging.data);
+        pixels_(cv::Rect(px1, py1, px2 - px1, py2 - py1)).copyTo(roi);
+        out = ncnn::Mat::from_pixels_resize(roi.data, ncnn::Mat::PIXEL_BGR2RGB, roi.cols, roi.rows, size, size, allocator_);
+        out.substract_mean_normalize(mean_vals_, norm_vals_);
+        return;
+    }
+
+    const ncnn::Mat& src = levels_[l];
+    float s = level_scales_[l];
+
+    int lx1 = std::min(std::max((int)round(x1 * s), 0), src.w - 1);
+    int ly1 = std::min(std::max((int)round(y1 * s), 0), src.h - 1);
+    int lx2 = std::min(std::max((int)round(x2 * s), lx1 + 1), src.w);
+    int ly2 = std::min(std::max((int)round(y2 * s), ly1 + 1), src.h);
+
+    ncnn::Mat tempIm;
+    copy_cut_border(src, tempIm, ly1, src.h - ly2, lx1, src.w - lx2, allocator_);
+    resize_bilinear(tempIm, out, size, size, allocator_);
+}
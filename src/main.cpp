@@ -1,4 +1,9 @@
+#include "adaptive_period.h"
+#include "async_detector.h"
 #include "camera.h"
+#include "detection_scheduler.h"
+#include "detection_service.h"
+#include "face_size_map.h"
 #include <chrono>
 #include <cstdlib>
 #include <face_attr.h>
@@ -6,6 +11,7 @@
 #include <image_quality.h>
 #include <iostream>
 #include <kcf/tracker.hpp>
+#include "motion_gate.h"
 #include "mtcnn.h"
 #include <opencv2/opencv.hpp>
 #include <string.h>
@@ -17,7 +23,38 @@
 using namespace std;
 using namespace cv;
 
-void process_camera(const string &model_path, const CameraConfig &camera, string output_folder, const FaceAttr &fa) {
+/*
+ * move a face detected on an earlier frame to the current one: a face that
+ * overlapped a tracker box on the detection frame moves and scales with that
+ * tracker, other faces stay where they were detected
+ */
+static Rect2d compensate_motion(const Rect2d &face, const vector<Rect2d> &detection_boxes, const vector<Rect2d> &tracker_boxes, const Mat &frame) {
+    Rect2d moved = face;
+    for (size_t i = 0; i < detection_boxes.size(); i++) {
+        if (overlap(face, detection_boxes[i])) {
+            const Rect2d &then = detection_boxes[i], &now = tracker_boxes[i];
+            double scale = then.width > 0 ? now.width / then.width : 1;
+            moved.width = face.width * scale;
+            moved.height = face.height * scale;
+            moved.x = now.x + now.width / 2 + (face.x + face.width / 2 - then.x - then.width / 2) * scale - moved.width / 2;
+            moved.y = now.y + now.height / 2 + (face.y + face.height / 2 - then.y - then.height / 2) * scale - moved.height / 2;
+            break;
+        }
+    }
+    return moved & Rect2d(0, 0, frame.cols, frame.rows);
+}
+
+// detection setup shared by all cameras
+struct DetectionContext {
+    string model_path;
+    shared_ptr<const MTCNNModel> model; // null when each camera loads its own model
+    MTCNNOptions options;
+    shared_ptr<DetectionService> service; // null when each camera runs its own detector
+    shared_ptr<DetectionScheduler> scheduler;
+    float deadline_ms; // time budget of one detection, 0 for none
+};
+
+void process_camera(const DetectionContext &context, const CameraConfig &camera, int camera_slot, string output_folder, const FaceAttr &fa) {
 
     cout << "processing camera: " << camera.identity() << endl;
 
@@ -34,8 +71,45 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
     struct timeval  tv1,tv2;
     struct timezone tz1,tz2;
 
-    MTCNN mm(model_path);
+    // the ncnn model is shared, other backends load a model per camera
+    const MTCNNOptions &options = context.options;
+    const shared_ptr<DetectionService> &service = context.service;
+    DetectionScheduler &scheduler = *context.scheduler;
+    // without the service, detection runs beside the tracking loop, on a copy of the frame
+    unique_ptr<MTCNN> detector;
+    unique_ptr<AsyncDetector> async_detector;
+    if (!service) {
+        detector.reset(context.model ? new MTCNN(context.model, options) : new MTCNN(context.model_path, options));
+        async_detector.reset(new AsyncDetector(*detector));
+        LOG(INFO) << "detector of camera " << camera.identity() << " runs on " << detector->numThreads() << " threads";
+    }
+    future<vector<Bbox>> pending_detection;
+    Mat detection_frame;
+    // the camera's turn within the detection period of all cameras
+    int detection_frame_id = 0, next_detection_frame = scheduler.phase(camera_slot, camera.detection_period);
+    long deferred_frames = 0;
+    AdaptivePeriod adaptive_period(camera.detection_period,
+                                   camera.min_detection_period > 0 ? camera.min_detection_period : camera.detection_period,
+                                   camera.max_detection_period > 0 ? camera.max_detection_period : camera.detection_period);
+    // skips detections of a still scene, PNet only scans what moved
+    MotionGate motion_gate;
+    DetectParams detect_params;
+    if (!camera.exclusion_zones.empty())
+        detect_params.exclusions = make_shared<ExclusionMask>(camera.exclusion_zones);
+    // pyramid scales that found the camera's faces
+    if (camera.scale_window > 0)
+        detect_params.scale_history = make_shared<ScaleHistory>(camera.scale_window, camera.scale_sweep);
+    detect_params.deadline_ms = context.deadline_ms;
+    detect_params.detection_width = camera.detection_width;
+    detect_params.refine_landmarks = camera.refine_landmarks;
+    // expected face sizes per band, configured or learned from the detections
+    FaceSizeMap size_map = camera.face_sizes.empty() ? FaceSizeMap(camera.face_size_bands) : FaceSizeMap(camera.face_sizes);
+    // detections restricted to the entry zones and tracked faces, and full frame ones
+    long roi_detections = 0, full_detections = 0;
+    vector<Rect> motion_regions;
+    vector<Rect2d> detection_tracker_boxes; // tracker_boxes on detection_frame
     vector<Bbox> detected_bounding_boxes;
+    vector<Rect2d> detected_faces; // detected_bounding_boxes moved to the current frame
     Rect2d roi;
     vector<Ptr<Tracker>> trackers;
     vector<Rect2d> tracker_boxes;
@@ -66,6 +140,11 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
             cap = camera.GetCapture();
             if (!cap.isOpened()) {
                 LOG(ERROR) << "failed to open camera: " << camera.identity();
+                if (pending_detection.valid()) {
+                    // give the detection slot back to the other cameras
+                    pending_detection.wait();
+                    scheduler.finish();
+                }
                 return;
             }
             LOG(INFO) << "reopen camera: " << camera.identity();
@@ -81,17 +160,98 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
             log += "#" + to_string(trackers[i]->id) + " ";
         }
 
-        if (frameCounter % camera.detection_period == 0)
+        // trackers are only created and removed when a detection is merged, so
+        // detection_tracker_boxes[i] and tracker_boxes[i] are the same tracker
+        bool detection_due = !pending_detection.valid() && frameCounter >= next_detection_frame;
+        const bool moved = detection_due && motion_gate.check(frame, detect_params.regions, trackers.empty());
+        if (detection_due && !moved && trackers.empty())
+        {
+            // nothing moved and nothing to verify, wait for the next period
+            detection_due = false;
+            next_detection_frame = frameCounter + adaptive_period.period();
+            // saved by the gate, not by the period
+            adaptive_period.countSkip();
+        }
+        if (detection_due && !scheduler.tryStart())
+        {
+            // all detection slots are busy, try again on the next frame
+            detection_due = false;
+            deferred_frames++;
+        }
+        if (detection_due)
         {
             LOG(INFO) << log;
-            enable_detection = true;
+            next_detection_frame = frameCounter + adaptive_period.period();
+            motion_gate.commit();
+            detection_frame = frame.clone();
+            detection_frame_id = frameCounter;
+            detection_tracker_boxes = tracker_boxes;
+            bool full_scan = false;
+            if (camera.roi_full_scan > 0) {
+                // new faces come through the entry zones, anything else is caught by the full scans
+                full_scan = (roi_detections + full_detections) % camera.roi_full_scan == 0
+                            || (camera.entry_zones.empty() && tracker_boxes.empty());
+                if (full_scan) {
+                    // the whole frame, narrowed to the areas that moved
+                    full_detections++;
+                } else {
+                    // the entry zones where something moved
+                    motion_regions.swap(detect_params.regions);
+                    detect_params.regions.clear();
+                    for (size_t i = 0; i < camera.entry_zones.size(); i++)
+                        for (size_t k = 0; k < motion_regions.size(); k++) {
+                            Rect r = camera.entry_zones[i] & motion_regions[k];
+                            if (r.area() > 0)
+                                detect_params.regions.push_back(r);
+                        }
+                    // without any region the whole frame would be scanned
+                    if (detect_params.regions.empty() && tracker_boxes.empty())
+                        detect_params.regions = camera.entry_zones;
+                    roi_detections++;
+                }
+            }
+            // tracked faces are verified even when they stand still
+            for (size_t i = 0; i < tracker_boxes.size() && !full_scan; i++) {
+                const Rect2d &box = tracker_boxes[i];
+                detect_params.regions.push_back(Rect(box.x - box.width / 2, box.y - box.height / 2, box.width * 2, box.height * 2));
+            }
 
-            ncnn::Mat ncnn_img = ncnn::Mat::from_pixels(frame.data, ncnn::Mat::PIXEL_BGR2RGB, frame.cols, frame.rows);
+            size_map.bands(detection_frame.rows, detect_params.size_bands);
 
             gettimeofday(&tv1,&tz1);
-            mm.detect(ncnn_img, detected_bounding_boxes);
+            if (service)
+                pending_detection = service->submit(detection_frame, detect_params);
+            else
+                pending_detection = async_detector->submit(detection_frame, detect_params);
+        }
+
+        if (pending_detection.valid() && pending_detection.wait_for(chrono::seconds(0)) == future_status::ready)
+        {
+            enable_detection = true;
+            detected_bounding_boxes = pending_detection.get();
             gettimeofday(&tv2,&tz2);
-            int total = 0;
+            scheduler.finish();
+
+            // largest tracker motion since the detection frame, in box widths
+            float motion = 0;
+            for (size_t i = 0; i < detection_tracker_boxes.size(); i++) {
+                const Rect2d &then = detection_tracker_boxes[i], &now = tracker_boxes[i];
+                double dx = now.x + now.width / 2 - then.x - then.width / 2;
+                double dy = now.y + now.height / 2 - then.y - then.height / 2;
+                if (then.width > 0)
+                    motion = max(motion, (float)(sqrt(dx * dx + dy * dy) / then.width));
+            }
+
+            size_map.update(detected_bounding_boxes, detection_frame.rows);
+
+            detected_faces.clear();
+            for (size_t k = 0; k < detected_bounding_boxes.size(); k++) {
+                const Bbox &box = detected_bounding_boxes[k];
+                Rect2d detected_face(Point(box.x1, box.y1),Point(box.x2, box.y2));
+                detected_faces.push_back(compensate_motion(detected_face, detection_tracker_boxes, tracker_boxes, frame));
+            }
+
+            int total = 0, new_faces = 0;
 
             // update trackers' bounding boxes and create tracker for a new face
             for(vector<Bbox>::iterator it=detected_bounding_boxes.begin(); it!=detected_bounding_boxes.end();it++) {
@@ -102,7 +262,10 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
                     Bbox box = *it;
 
                     //std::vector<double> qualities = fa.GetQuality(cimg, box.x1, box.y1, box.x2, box.y2);
-                    Rect2d detected_face(Point(box.x1, box.y1),Point(box.x2, box.y2));
+                    // on detection_frame
+                    Rect2d detection_face(Point(box.x1, box.y1),Point(box.x2, box.y2));
+                    // on the current frame
+                    Rect2d detected_face = detected_faces[it - detected_bounding_boxes.begin()];
 
                     // test whether is a new face
                     bool newFace = true;
@@ -114,7 +277,7 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
                         }
                     }
 
-                    if (newFace) {
+                    if (newFace && detected_face.area() > 0) {
                         // create a new tracker if a new face is detected
                         Ptr<Tracker> tracker = TrackerKCF::create(kcf_param);
                         tracker->init(frame, detected_face);
@@ -122,16 +285,16 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
                         trackers.push_back(tracker);
                         tracker_boxes.push_back(detected_face);
                         selected_faces.push_back(box);
-                        Mat cloned_frame = frame.clone();
-                        selected_frames.push_back(cloned_frame);
+                        selected_frames.push_back(detection_frame);
                         // calculate score of the selected face
-                        Mat face(frame, detected_face);
+                        Mat face(detection_frame, detection_face);
                         double score = GetVarianceOfLaplacianSharpness(face);
                         scores.push_back(score);
                         LOG(INFO) << "\tstart tracking face #" << tracker->id << ", score: " << score;
+                        new_faces++;
                         
                         faceId++;
-                    } else {
+                    } else if (!newFace) {
                         // update tracker's bounding box
                         trackers[i]->reset(frame, detected_face);
                         tracker_boxes[i] = detected_face;
@@ -139,7 +302,64 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
                 }
             }
 
-            LOG(INFO) << "\tdetected " << total << " Persons. time eclipsed: " <<  getElapse(&tv1, &tv2) << " ms";
+            LOG(INFO) << "\tdetected " << total << " Persons on frame #" << detection_frame_id << ", " << frameCounter - detection_frame_id
+                      << " frames ago. time eclipsed: " <<  getElapse(&tv1, &tv2) << " ms";
+            adaptive_period.update(total, new_faces, motion, getElapse(&tv1, &tv2));
+            // a period shortened by this detection applies right away
+            next_detection_frame = min(next_detection_frame, detection_frame_id + adaptive_period.period());
+            LOG(INFO) << "\tdetection period: " << adaptive_period.period() << " frames, " << adaptive_period.detections() << " detections, "
+                      << adaptive_period.savedDetections() << " fewer than every " << camera.detection_period << " frames (~"
+                      << adaptive_period.savedMs() << " ms detection time saved)";
+            const MotionGateStats &gate = motion_gate.stats();
+            LOG(INFO) << "\tmotion gate: " << gate.skipped << " of " << gate.checked << " detections skipped (~"
+                      << gate.skipped * adaptive_period.meanDetectMs() << " ms detection time saved), " << gate.passed << " passed";
+            if (!size_map.empty())
+                LOG(INFO) << "\tface size map: " << size_map.knownBands() << " bands "
+                          << (size_map.learning() ? "learned, " + to_string(size_map.sweeps()) + " unpruned detections" : "configured");
+            if (detect_params.scale_history) {
+                ScaleHistoryStats history = detect_params.scale_history->stats();
+                string scales;
+                for (size_t k = 0; k < history.faces.size(); k++)
+                    scales += " " + to_string(history.faces[k]) + "/" + to_string(history.skipped[k]);
+                LOG(INFO) << "\tpyramid scales, faces/skipped detections:" << scales << ", " << history.sweeps << " of "
+                          << history.detections << " detections scanned every scale";
+            }
+            if (detect_params.exclusions) {
+                vector<long> counts = detect_params.exclusions->counts();
+                string excluded;
+                for (size_t k = 0; k < counts.size(); k++)
+                    excluded += " " + to_string(counts[k]);
+                LOG(INFO) << "\texclusion zones dropped candidates:" << excluded;
+            }
+            if (camera.roi_full_scan > 0)
+                LOG(INFO) << "\troi: " << roi_detections << " detections on " << camera.entry_zones.size() << " entry zones and the tracked faces, "
+                          << full_detections << " on the full frame";
+            SchedulerStats schedule = scheduler.stats();
+            string spread;
+            for (size_t k = 0; k <= (size_t)schedule.max_running && k < schedule.running.size(); k++)
+                spread += " " + to_string(schedule.running[k]);
+            LOG(INFO) << "\tschedule: " << deferred_frames << " frames deferred on this camera, " << schedule.deferred << " of "
+                      << schedule.started << " detections on all cameras, started beside 0.." << schedule.max_running - 1 << " others:" << spread;
+            if (service) {
+                DetectionServiceStats stats = service->stats();
+                LOG(INFO) << "\tdetection service: " << stats.requests << " frames in " << stats.batches << " batches (max "
+                          << stats.max_batch << "), queue wait: " << stats.queue_wait_ms / max(1L, stats.requests) << " ms avg, "
+                          << stats.max_wait_ms << " ms max, detection: " << stats.detect_ms / max(1L, stats.batches) << " ms per batch, "
+                          << stats.incomplete << " frames cut by the deadline";
+            } else {
+                const DetectStats &stats = detector->stats();
+                LOG(INFO) << "\tpyramid: " << stats.pyramid_ms << " ms, pnet: " << stats.pnet_ms << " ms (" << (int)(stats.pnet_area * 100)
+                          << "% scanned, " << stats.coarse_regions << " coarse regions), rnet: " << stats.rnet_ms << " ms (" << stats.pnet_boxes
+                          << " boxes), onet: " << stats.onet_ms << " ms (" << stats.rnet_boxes << " boxes)";
+                if (stats.capped_boxes > 0) {
+                    const CandidateCapCounters &caps = detector->capCounters();
+                    LOG(INFO) << "\tcandidate limits dropped " << stats.capped_boxes << " boxes, frames capped by rnet top-k: " << caps.rnet_topk
+                              << ", onet top-k: " << caps.onet_topk << ", budget: " << caps.frame_budget << ", deadline: " << caps.deadline
+                              << " of " << caps.frames;
+                }
+                if (stats.deadline_hit)
+                    LOG(INFO) << "\tdeadline of " << context.deadline_ms << " ms hit, " << (int)(stats.completeness * 100) << "% of the detection done";
+            }
         }
 
         // clean up trackers if the tracker doesn't follow a face
@@ -154,18 +374,18 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
                     if ((*it).exist) {
                         Bbox box = *it;
 
-                        Rect2d detected_face(Point(box.x1, box.y1),Point(box.x2, box.y2));
+                        Rect2d detection_face(Point(box.x1, box.y1),Point(box.x2, box.y2));
+                        Rect2d detected_face = detected_faces[it - detected_bounding_boxes.begin()];
                         if (overlap(detected_face, tracker_boxes[i])) {
                             isFace = true;
                             // update face score
                             // Mat face(frame, tracker_boxes[i]);
-                            Mat face(frame, detected_face);
+                            Mat face(detection_frame, detection_face);
                             double score = GetVarianceOfLaplacianSharpness(face);
                             if (score > scores[i]) {
                                 // select a better face
                                 LOG(INFO) << "\tupdate selected face, new score: " << score;
-                                Mat cloned_frame = frame.clone();
-                                selected_frames[i] = cloned_frame;
+                                selected_frames[i] = detection_frame;
                                 selected_faces[i] = box;
                                 scores[i] = score;
                             }
@@ -199,6 +419,7 @@ void process_camera(const string &model_path, const CameraConfig &camera, string
         // imshow("window", show_frame);
 
         frameCounter++;
+        adaptive_period.countFrame();
 
         google::FlushLogFiles(google::GLOG_INFO);
 
@@ -215,6 +436,21 @@ int main(int argc, char* argv[]) {
         "{model        |models/ncnn                | path to mtcnn model  }"
         "{config       |/opt/dev_keeper/keeper.toml| camera config        }"
         "{output       |/opt/dev_keeper/faces      | output folder        }"
+        "{batch        |true                       | batch RNet/ONet crops}"
+        "{int8         |false                      | use the int8 models  }"
+        "{threads      |0                          | threads per camera, 0 for OMP default}"
+        "{service      |false                      | one detection service for all cameras}"
+        "{backend      |ncnn                       | ncnn or opencv (Caffe models)}"
+        "{transpose    |true                       | transposed input of the Caffe models}"
+        "{max_detections|0                         | concurrent detections, 0 for no limit}"
+        "{rnet_topk    |0                          | max RNet candidates  }"
+        "{onet_topk    |0                          | max ONet candidates  }"
+        "{budget       |0                          | max crops per frame  }"
+        "{coarse_to_fine|false                     | PNet on finer scales only around coarse hits}"
+        "{pre_threshold|0.4                        | coarse score that opens a finer window}"
+        "{dense_every  |0                          | dense PNet every N detections, 0 never}"
+        "{deadline_ms  |0                          | time budget of a detection, 0 for none}"
+        "{pnet_tile    |0                          | PNet tile size of large levels, 0 for no tiles}"
     ;
 
     CommandLineParser parser(argc, argv, keys);
@@ -229,6 +465,23 @@ int main(int argc, char* argv[]) {
 
     String model_path = parser.get<String>("model");
     String output_folder = parser.get<String>("output");
+    MTCNNOptions options;
+    options.num_threads = parser.get<int>("threads");
+    options.batch_stages = parser.get<bool>("batch");
+    options.int8 = parser.get<bool>("int8");
+    options.limits.rnet_topk = parser.get<int>("rnet_topk");
+    options.limits.onet_topk = parser.get<int>("onet_topk");
+    options.limits.frame_budget = parser.get<int>("budget");
+    options.coarse_to_fine.enable = parser.get<bool>("coarse_to_fine");
+    options.coarse_to_fine.pre_threshold = parser.get<float>("pre_threshold");
+    options.coarse_to_fine.dense_every = parser.get<int>("dense_every");
+    options.pnet_tile_size = parser.get<int>("pnet_tile");
+    bool use_service = parser.get<bool>("service");
+    int max_detections = parser.get<int>("max_detections");
+    String backend = parser.get<String>("backend");
+    if (backend == "opencv")
+        options.backend = BACKEND_OPENCV_DNN;
+    options.transpose_input = parser.get<bool>("transpose");
     if (!parser.check()) {
         parser.printErrors();
         return 0;
@@ -241,11 +494,38 @@ int main(int argc, char* argv[]) {
     CameraConfig main_camera = cameras[cameras.size()-1];
     cameras.pop_back();
 
-    for (CameraConfig camera: cameras) {
+    // the ncnn model is loaded once and shared by the detectors of all cameras
+    DetectionContext context;
+    context.model_path = model_path;
+    context.options = options;
+    context.deadline_ms = parser.get<float>("deadline_ms");
+    context.scheduler = make_shared<DetectionScheduler>(cameras.size() + 1, max_detections);
+    if (options.backend == BACKEND_NCNN) {
+        struct timeval tv1, tv2;
+        long rss_before = get_resident_memory_kb();
+        gettimeofday(&tv1, NULL);
+        context.model = MTCNNModel::load(model_path, options.int8);
+        gettimeofday(&tv2, NULL);
+        if (!context.model) {
+            LOG(ERROR) << "failed to load the model: " << model_path;
+            return 1;
+        }
+        LOG(INFO) << "model loaded in " << getElapse(&tv1, &tv2) << " ms, resident memory: " << rss_before
+                  << " kB -> " << get_resident_memory_kb() << " kB, shared by " << cameras.size() + 1 << " cameras";
+    } else if (use_service) {
+        LOG(ERROR) << "the detection service runs on the ncnn backend only";
+        return 1;
+    }
+
+    // with --service the cameras queue their frames to one detector, which batches RNet/ONet across cameras
+    if (use_service)
+        context.service = make_shared<DetectionService>(context.model, options, cameras.size() + 1);
+
+    for (size_t i = 0; i < cameras.size(); i++) {
         // start processing video
-        thread t {process_camera, model_path, camera, output_folder, fa};
+        thread t {process_camera, context, cameras[i], i, output_folder, fa};
         t.detach();
     }
 
-    process_camera(model_path, main_camera, output_folder, fa);
+    process_camera(context, main_camera, cameras.size(), output_folder, fa);
 }
@@ -0,0 +1,47 @@
+#include "motion_gate.h"
+
+MotionGate::MotionGate(int width, int threshold, float min_area)
+    : width_(width), threshold_(threshold), min_area_(min_area), stats_() {
+}
+
+bool MotionGate::check(const cv::Mat& frame, std::vector<cv::Rect>& regions, bool can_skip) {
+    regions.clear();
+    stats_.checked++;
+
+    int height = std::max(1, frame.rows * width_ / frame.cols);
+    cv::resize(frame, small_, cv::Size(width_, height), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+    cv::GaussianBlur(gray_, gray_, cv::Size(5, 5), 0);
+
+    if (previous_.empty()) {
+        stats_.passed++;
+        regions.push_back(cv::Rect(0, 0, frame.cols, frame.rows));
+        return true;
+    }
+
+    cv::absdiff(gray_, previous_, diff_);
+    cv::threshold(diff_, diff_, threshold_, 255, cv::THRESH_BINARY);
+    if (cv::countNonZero(diff_) < min_area_ * diff_.total()) {
+        if (can_skip)
+            stats_.skipped++;
+        return false;
+    }
+
+    // join the moving pixels of one person into one area
+    cv::dilate(diff_, diff_, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5)));
+    cv::findContours(diff_, contours_, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    const float factor = (float)frame.cols / width_;
+    const cv::Rect bounds(0, 0, frame.cols, frame.rows);
+    for (size_t i = 0; i < contours_.size(); i++) {
+        cv::Rect r = cv::boundingRect(contours_[i]);
+        cv::Rect region(r.x * factor, r.y * factor, r.width * factor, r.height * factor);
+        regions.push_back(region & bounds);
+    }
+    stats_.passed++;
+    return true;
+}
+
+void MotionGate::commit() {
+    gray_.copyTo(previous_);
+}
@@ -1,135 +1,164 @@
 #include <algorithm>
+#include <cfloat>
+#include <climits>
 #include <math.h>
+#include <string.h>
 #include <iostream>
 #include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <opencv2/opencv.hpp>
 #include "mtcnn.h"
+#include "ncnn_backend.h"
+#include "opencv_dnn_backend.h"
 #include "utils.h"
 
-bool cmpScore(orderScore lsh, orderScore rsh){
-    if(lsh.score<rsh.score)
-        return true;
-    else
-        return false;
+MTCNN::MTCNN(const MTCNNOptions& options){
+    setup(options);
 }
 
+MTCNN::MTCNN(const std::string& model_path, const MTCNNOptions& options){
+    setup(options);
+    if(options.backend == BACKEND_OPENCV_DNN){
+        OpenCVDnnBackend *backend = new OpenCVDnnBackend(model_path, options.transpose_input);
+        backend_.reset(backend);
+        if(!backend->loaded())
+            backend_.reset();
+        return;
+    }
 
-MTCNN::MTCNN(){
-
+    std::shared_ptr<const MTCNNModel> model = MTCNNModel::load(model_path, options.int8);
+    if(model)
+        backend_.reset(new NcnnBackend(model, num_threads_, light_mode_, blob_pool_, workspace_pool_));
 }
 
-MTCNN::MTCNN(const std::string& model_path){
-    std::vector<std::string> param_files = {
-		model_path+"/det1.param",
-		model_path+"/det2.param",
-		model_path+"/det3.param"
-	};
-
-	std::vector<std::string> bin_files = {
-		model_path+"/det1.bin",
-		model_path+"/det2.bin",
-		model_path+"/det3.bin"
-	};
+MTCNN::MTCNN(std::shared_ptr<const MTCNNModel> model, const MTCNNOptions& options){
+    setup(options);
+    if(model)
+        backend_.reset(new NcnnBackend(model, num_threads_, light_mode_, blob_pool_, workspace_pool_));
+}
 
-	pnet_.load_param(param_files[0].c_str());
-	pnet_.load_model(bin_files[0].c_str());
-	rnet_.load_param(param_files[1].c_str());
-	rnet_.load_model(bin_files[1].c_str());
-	onet_.load_param(param_files[2].c_str());
-	onet_.load_model(bin_files[2].c_str());
+void MTCNN::setup(const MTCNNOptions& options){
+    num_threads_ = options.num_threads;
+#ifdef _OPENMP
+    if(num_threads_ <= 0)
+        num_threads_ = omp_get_max_threads();
+#endif
+    if(num_threads_ <= 0)
+        num_threads_ = 1;
+
+    light_mode_ = options.light_mode;
+    if(options.pool_allocators){
+        blob_pool_ = &blob_allocator_;
+        workspace_pool_ = &workspace_allocator_;
+    }
+    batch_stages_ = options.batch_stages;
+    pnet_mosaic_ = options.pnet_mosaic;
+    coarse_to_fine_ = options.coarse_to_fine;
+    pnet_tile_size_ = options.pnet_tile_size;
+    limits_ = options.limits;
 
+    reserveBuffers();
 }
 
+// candidate buffers are sized up front so steady state detection does not grow them
+void MTCNN::reserveBuffers(){
+    pyramid_.setAllocator(blob_pool_);
+
+    scaleBbox_.reserve(RESERVED_CANDIDATES);
+    firstBbox_.reserve(RESERVED_CANDIDATES);
+    secondBbox_.reserve(RESERVED_CANDIDATES);
+    thirdBbox_.reserve(RESERVED_CANDIDATES);
+    stage_out_.reserve(RESERVED_CANDIDATES * STAGE_OUTPUT_SIZE);
+    stage_index_.reserve(RESERVED_CANDIDATES);
+    stage_crops_.reserve(RESERVED_CANDIDATES);
+    stage_batch_out_.reserve(RESERVED_CANDIDATES * STAGE_OUTPUT_SIZE);
+    nms_boxes_.reserve(RESERVED_CANDIDATES);
+    nms_index_.reserve(RESERVED_CANDIDATES);
+    nms_keep_.reserve(RESERVED_CANDIDATES);
+}
 
+size_t MTCNN::heapAllocations(){
+    return blob_allocator_.heapAllocations() + workspace_allocator_.heapAllocations();
+}
 
-void MTCNN::generateBbox(ncnn::Mat score, ncnn::Mat location, std::vector<Bbox>& boundingBox_, std::vector<orderScore>& bboxScore_, float scale){
+void MTCNN::generateBbox(ncnn::Mat score, ncnn::Mat location, std::vector<Bbox>& boundingBox_, float scale, const ScoreWindow& window){
     int stride = 2;
     int cellsize = 12;
-    int count = 0;
     //score p
-    float *p = score.channel(1);
+    const float *p = score.channel(1);
     Bbox bbox;
-    orderScore order;
-    for(int row=0;row<score.h;row++){
-        for(int col=0;col<score.w;col++){
-            if(*p>threshold[0]){
-                bbox.score = *p;
-                order.score = *p;
-                order.oriOrder = count;
-                bbox.x1 = round((stride*col+1)/scale);
-                bbox.y1 = round((stride*row+1)/scale);
-                bbox.x2 = round((stride*col+1+cellsize)/scale);
-                bbox.y2 = round((stride*row+1+cellsize)/scale);
+    for(int row=window.row;row<window.row+window.rows;row++){
+        for(int col=window.col;col<window.col+window.cols;col++){
+            int offset = row*score.w + col;
+            if(p[offset]>threshold[0]){
+                int x = stride*col + window.dx;
+                int y = stride*row + window.dy;
+                bbox.score = p[offset];
+                bbox.x1 = round((x+1)/scale);
+                bbox.y1 = round((y+1)/scale);
+                bbox.x2 = round((x+1+cellsize)/scale);
+                bbox.y2 = round((y+1+cellsize)/scale);
                 bbox.exist = true;
                 bbox.area = (bbox.x2 - bbox.x1)*(bbox.y2 - bbox.y1);
                 for(int channel=0;channel<4;channel++)
-                    bbox.regreCoord[channel]=location.channel(channel)[0];
+                    bbox.regreCoord[channel]=location.channel(channel)[offset];
                 boundingBox_.push_back(bbox);
-                bboxScore_.push_back(order);
-                count++;
             }
-            p++;
-            // plocal++;
         }
     }
 }
 
-// nms: non maximum suppression
+// nms: non maximum suppression over the existing boxes, see NmsEngine
 // IOU: intersection over union
-void MTCNN::nms(std::vector<Bbox> &boundingBox_, std::vector<orderScore> &bboxScore_, const float overlap_threshold, string modelname){
+void MTCNN::nms(std::vector<Bbox> &boundingBox_, const float overlap_threshold, NmsMode mode){
     if(boundingBox_.empty()){
         return;
     }
-    std::vector<int> heros;
-    //sort the score
-    sort(bboxScore_.begin(), bboxScore_.end(), cmpScore);
-
-    int order = 0;
-    float IOU = 0;
-    float maxX = 0;
-    float maxY = 0;
-    float minX = 0;
-    float minY = 0;
-    while(bboxScore_.size()>0){
-        order = bboxScore_.back().oriOrder;
-        bboxScore_.pop_back();
-        if(order<0)continue;
-        if(boundingBox_.at(order).exist == false) continue;
-        heros.push_back(order);
-        boundingBox_.at(order).exist = false;//delete it
-
-        for(int num=0;num<boundingBox_.size();num++){
-            if(boundingBox_.at(num).exist){
-                // Compute ordinates of intersection-over-union(IOU)
-                maxX = (boundingBox_.at(num).x1>boundingBox_.at(order).x1)?boundingBox_.at(num).x1:boundingBox_.at(order).x1;
-                maxY = (boundingBox_.at(num).y1>boundingBox_.at(order).y1)?boundingBox_.at(num).y1:boundingBox_.at(order).y1;
-                minX = (boundingBox_.at(num).x2<boundingBox_.at(order).x2)?boundingBox_.at(num).x2:boundingBox_.at(order).x2;
-                minY = (boundingBox_.at(num).y2<boundingBox_.at(order).y2)?boundingBox_.at(num).y2:boundingBox_.at(order).y2;
-
-                //Compute areas of intersection-over-union
-                maxX = ((minX-maxX+1)>0)?(minX-maxX+1):0;
-                maxY = ((minY-maxY+1)>0)?(minY-maxY+1):0;
-                IOU = maxX * maxY;
-
-                if(!modelname.compare("Union"))
-                    IOU = IOU/(boundingBox_.at(num).area + boundingBox_.at(order).area - IOU);
-                else if(!modelname.compare("Min")){
-                    IOU = IOU/((boundingBox_.at(num).area<boundingBox_.at(order).area)?boundingBox_.at(num).area:boundingBox_.at(order).area);
-                }
-                if(IOU>overlap_threshold){
-                    boundingBox_.at(num).exist=false;
-                    for(vector<orderScore>::iterator it=bboxScore_.begin(); it!=bboxScore_.end();it++){
-                        if((*it).oriOrder == num) {
-                            (*it).oriOrder = -1;
-                            break;
-                        }
-                    }
-                }
-            }
+
+    nms_boxes_.clear();
+    nms_index_.clear();
+    for(size_t i = 0; i < boundingBox_.size(); i++){
+        const Bbox &box = boundingBox_[i];
+        if(box.exist){
+            nms_boxes_.push_back(box.x1, box.y1, box.x2, box.y2, box.area, box.score);
+            nms_index_.push_back(i);
+            boundingBox_[i].exist = false;
         }
     }
-    for(unsigned int i=0;i<heros.size();i++)
-        boundingBox_.at(heros.at(i)).exist = true;
+
+    nms_.run(nms_boxes_, overlap_threshold, mode, nms_keep_);
+    for(size_t i = 0; i < nms_keep_.size(); i++)
+        boundingBox_[nms_index_[nms_keep_[i]]].exist = true;
+}
+
+/*
+ * keep the min(topk, budget) best scoring boxes, the others are marked as not
+ * existing; returns the number of dropped boxes
+ */
+int MTCNN::capCandidates(vector<Bbox> &vecBbox, int topk, int budget, long &topk_counter){
+    stage_index_.clear();
+    for(size_t i = 0; i < vecBbox.size(); i++){
+        if(vecBbox[i].exist)
+            stage_index_.push_back(i);
+    }
+
+    int limit = std::min(topk, budget);
+    int count = stage_index_.size();
+    if(count <= limit)
+        return 0;
+
+    std::nth_element(stage_index_.begin(), stage_index_.begin() + limit, stage_index_.end(),
+                     [&vecBbox](int a, int b) { return vecBbox[a].score > vecBbox[b].score; });
+    for(int i = limit; i < count; i++)
+        vecBbox[stage_index_[i]].exist = false;
+
+    if(topk <= budget)
+        topk_counter++;
+    else
+        cap_counters_.frame_budget++;
+    return count - limit;
 }
 
 void MTCNN::refineAndSquareBbox(vector<Bbox> &vecBbox, const int &height, const int &width){
@@ -186,19 +215,506 @@ void MTCNN::refineAndSquareBbox(vector<Bbox> &vecBbox, const int &height, const
     }
 }
 
-void MTCNN::detect(ncnn::Mat& img_, std::vector<Bbox>& finalBbox_) {
-    firstBbox_.clear();
-    firstOrderScore_.clear();
-    secondBbox_.clear();
-    secondBboxScore_.clear();
-    thirdBbox_.clear();
-    thirdBboxScore_.clear();
+// input size of RNet and ONet
+static const int STAGE_SIZES[2] = {24, 48};
+
+/*
+ * Run RNet (size 24) or ONet (size 48) on every existing box, one inference per box.
+ * Crops are sampled from the nearest pyramid level.
+ * Outputs are written to stage_out_ at the box index.
+ */
+void MTCNN::runStage(int stage){
+    const int size = STAGE_SIZES[stage];
+    vector<Bbox>& vecBbox = stageInput(stage);
+    stage_out_.resize(vecBbox.size() * STAGE_OUTPUT_SIZE);
+    for(size_t i = 0; i < vecBbox.size(); i++){
+        const Bbox& box = vecBbox[i];
+        if(!box.exist)
+            continue;
+
+        ncnn::Mat in;
+        pyramid_.crop(box.x1, box.y1, box.x2, box.y2, size, in);
+        backend_->runStage(stage, in, 1, &stage_out_[i * STAGE_OUTPUT_SIZE]);
+    }
+}
+
+/*
+ * ONet once more over the faces found on a downscaled frame, with crops of
+ * the frame itself, for landmarks at full resolution. Boxes and scores stay.
+ */
+void MTCNN::refineLandmarks(const cv::Mat& frame, std::vector<Bbox>& finalBbox_){
+    const int size = STAGE_SIZES[STAGE_ONET];
+    stage_index_.clear();
+    for(size_t i = 0; i < finalBbox_.size(); i++){
+        if(finalBbox_[i].exist)
+            stage_index_.push_back(i);
+    }
+    const int n = stage_index_.size();
+    if(n == 0)
+        return;
+
+    ncnn::Mat batch(size, size, 3 * n, (size_t)4u, blob_pool_);
+    for(int k = 0; k < n; k++){
+        const Bbox& box = finalBbox_[stage_index_[k]];
+        int x1 = std::min(std::max(box.x1, 0), frame.cols - 1);
+        int y1 = std::min(std::max(box.y1, 0), frame.rows - 1);
+        int x2 = std::min(std::max(box.x2, x1 + 1), frame.cols);
+        int y2 = std::min(std::max(box.y2, y1 + 1), frame.rows);
+
+        // continuous copy of the box pixels, staged in a pool buffer
+        ncnn::Mat staging((x2 - x1) * 3, y2 - y1, (size_t)1u, blob_pool_);
+        cv::Mat roi(y2 - y1, x2 - x1, CV_8UC3, staging.data);
+        frame(cv::Rect(x1, y1, x2 - x1, y2 - y1)).copyTo(roi);
+        ncnn::Mat in = ncnn::Mat::from_pixels_resize(roi.data, ncnn::Mat::PIXEL_BGR2RGB, roi.cols, roi.rows, size, size, blob_pool_);
+        in.substract_mean_normalize(mean_vals, norm_vals);
+        for(int q = 0; q < 3; q++)
+            memcpy(batch.channel(3 * k + q), in.channel(q), size * size * sizeof(float));
+    }
+
+    stage_batch_out_.resize(n * STAGE_OUTPUT_SIZE);
+    backend_->runStage(STAGE_ONET, batch, n, &stage_batch_out_[0]);
+    for(int k = 0; k < n; k++){
+        Bbox& box = finalBbox_[stage_index_[k]];
+        const float *keyPoint = &stage_batch_out_[k * STAGE_OUTPUT_SIZE] + 5;
+        for(int num = 0; num < 5; num++){
+            box.ppoint[num] = box.x1 + (box.x2 - box.x1)*keyPoint[num];
+            box.ppoint[num+5] = box.y1 + (box.y2 - box.y1)*keyPoint[num+5];
+        }
+    }
+}
+
+/*
+ * Batched version of runStage over the boxes of one or more frames: all crops
+ * are packed into a single blob (3 channels per box) and the backend evaluates
+ * them in one call. The frames share the model, the first one provides the
+ * backend and the allocators.
+ */
+void MTCNN::runStageBatch(MTCNN* const* frames, int count, int stage){
+    MTCNN *first = frames[0];
+    const int size = STAGE_SIZES[stage];
+    std::vector<StageCrop>& crops = first->stage_crops_;
+    crops.clear();
+    for(int f = 0; f < count; f++){
+        const vector<Bbox>& vecBbox = frames[f]->stageInput(stage);
+        frames[f]->stage_out_.resize(vecBbox.size() * STAGE_OUTPUT_SIZE);
+        for(size_t i = 0; i < vecBbox.size(); i++){
+            if(vecBbox[i].exist){
+                StageCrop crop = {frames[f], (int)i};
+                crops.push_back(crop);
+            }
+        }
+    }
+    const int n = crops.size();
+    if(n == 0)
+        return;
+
+    ncnn::Mat batch(size, size, 3 * n, (size_t)4u, first->blob_pool_);
+
+    #pragma omp parallel for num_threads(first->num_threads_)
+    for(int k = 0; k < n; k++){
+        const Bbox& box = crops[k].frame->stageInput(stage)[crops[k].box];
+        ncnn::Mat in;
+        crops[k].frame->pyramid_.crop(box.x1, box.y1, box.x2, box.y2, size, in);
+        for(int q = 0; q < 3; q++){
+            float *dst = batch.channel(3 * k + q);
+            const float *src = in.channel(q);
+            memcpy(dst, src, size * size * sizeof(float));
+        }
+    }
+
+    std::vector<float>& out = first->stage_batch_out_;
+    out.resize(n * STAGE_OUTPUT_SIZE);
+    first->backend_->runStage(stage, batch, n, &out[0]);
+    for(int k = 0; k < n; k++)
+        memcpy(&crops[k].frame->stage_out_[crops[k].box * STAGE_OUTPUT_SIZE], &out[k * STAGE_OUTPUT_SIZE], STAGE_OUTPUT_SIZE * sizeof(float));
+}
+
+// excluded candidates and per scale nms, then keep the survivors of scaleBbox_ as first stage candidates of scale level
+void MTCNN::appendScaleBbox(int level){
+    if(params_.exclusions)
+        stats_.excluded_boxes += params_.exclusions->suppress(scaleBbox_, detection_factor_x_, detection_factor_y_);
+    nms(scaleBbox_, nms_threshold[0]);
+    for(vector<Bbox>::iterator it=scaleBbox_.begin(); it!=scaleBbox_.end();it++){
+        if((*it).exist){
+            it->level = level;
+            firstBbox_.push_back(*it);
+        }
+    }
+    scaleBbox_.clear();
+}
+
+/*
+ * PNet over every pyramid scale, one inference per scale.
+ *
+ * In coarse to fine mode the scales run from the coarsest one: the coarse
+ * levels are scanned as usual, the finer ones only around the cells of the
+ * coarser levels that passed the pre-threshold.
+ */
+void MTCNN::runPNet(const vector<float>& scales_){
+    const int n = scales_.size();
+    const bool coarse_to_fine = coarse_to_fine_.enable && !(coarse_to_fine_.dense_every > 0 && coarse_frames_++ % coarse_to_fine_.dense_every == 0);
+    if (coarse_to_fine) {
+        coarse_mask_.create((int)ceil(img_h * COARSE_MASK_WIDTH / (float)img_w), COARSE_MASK_WIDTH, CV_8UC1);
+        coarse_mask_.setTo(0);
+        coarse_regions_.clear();
+    }
+
+    scaleOrder(coarse_to_fine, scale_order_);
+    const float pnet_deadline = params_.deadline_ms * PNET_DEADLINE_SHARE;
+    long scanned = 0, total = 0;
+    int planned = 0, done = 0, scanned_coarse = 0;
+    for (int step = 0; step < n; step++) {
+        const int i = scale_order_[step];
+        const ncnn::Mat& level = pyramid_.scaleLevel(i);
+        total += level.w * level.h;
+        if (!scale_active_.empty() && !scale_active_[i])
+            continue;
+        planned++;
+        if (params_.deadline_ms > 0 && done > 0 && elapsedMs() >= pnet_deadline) {
+            stats_.deadline_hit = true;
+            continue;
+        }
+        done++;
+
+        // the coarse levels are the first ones actually scanned, skipped
+        // scales do not count
+        const bool fine = coarse_to_fine && scanned_coarse >= coarse_to_fine_.coarse_levels;
+        if (fine) {
+            // the hits of the coarser levels, nothing to scan without one
+            findCoarseRegions();
+            if (coarse_regions_.empty())
+                continue;
+            scanWindows(i, coarse_regions_, scan_windows_);
+        }
+        else {
+            scanWindows(i, params_.regions, scan_windows_);
+            scanned_coarse++;
+        }
+
+        for (size_t k = 0; k < scan_windows_.size(); k++)
+            scanned += scan_windows_[k].area();
+        tileWindows(scan_windows_, pnet_tiles_);
+
+        const int tiles = pnet_tiles_.size();
+        tile_in_.resize(tiles);
+        tile_score_.resize(tiles);
+        tile_location_.resize(tiles);
+        for (int k = 0; k < tiles; k++) {
+            const cv::Rect& r = pnet_tiles_[k].input;
+            ncnn::Mat& in = tile_in_[k];
+            in = level;
+            if (r.width != level.w || r.height != level.h) {
+                in.create(r.width, r.height, 3, (size_t)4u, blob_pool_);
+                for(int q = 0; q < 3; q++){
+                    const float *src = level.channel(q);
+                    float *dst = in.channel(q);
+                    for(int row = 0; row < r.height; row++)
+                        memcpy(dst + row * r.width, src + (r.y + row) * level.w + r.x, r.width * sizeof(float));
+                }
+            }
+        }
+        if (tiles > 0)
+            backend_->runPNetTiles(&tile_in_[0], tiles, &tile_score_[0], &tile_location_[0]);
+
+        for (int k = 0; k < tiles; k++) {
+            const PNetTile& tile = pnet_tiles_[k];
+            const ncnn::Mat& score_ = tile_score_[k];
+            ScoreWindow window = {0, 0, std::min(tile.cols, score_.w), std::min(tile.rows, score_.h), tile.input.x, tile.input.y};
+            generateBbox(score_, tile_location_[k], scaleBbox_, scales_[i], window);
+            if (coarse_to_fine)
+                markCoarseHits(score_, window, scales_[i]);
+            // back to the pool for the next level
+            tile_in_[k].release();
+            tile_score_[k].release();
+            tile_location_[k].release();
+        }
+        appendScaleBbox(i);
+    }
+    stats_.pnet_area = total > 0 ? (float)scanned / total : 0;
+    if (planned > 0)
+        stats_.completeness *= (float)done / planned;
+}
+
+/*
+ * order PNet scans the scales in. Under a deadline the scales that found the
+ * most faces of the camera go first, then the others from the coarsest
+ * (cheapest) one; coarse to fine mode keeps the coarsest first order, and
+ * without either from the finest one.
+ */
+void MTCNN::scaleOrder(bool coarse_first, std::vector<int>& order){
+    const int n = scales_.size();
+    const bool priority = params_.deadline_ms > 0;
+    order.resize(n);
+    for (int i = 0; i < n; i++)
+        order[i] = coarse_first || priority ? n - 1 - i : i;
+    if (coarse_first || !priority || !params_.scale_history)
+        return;
+
+    std::vector<long> faces = params_.scale_history->stats().faces;
+    if ((int)faces.size() != n)
+        return;
+    std::stable_sort(order.begin(), order.end(), [&faces](int a, int b) { return faces[a] > faces[b]; });
+}
+
+/*
+ * drop the candidates of a refinement stage the deadline leaves no time for,
+ * the best scores stay; share is the part of the time left the stage may take
+ */
+void MTCNN::capDeadline(vector<Bbox> &vecBbox, int stage, float share){
+    int allowed = deadlineCandidates(crop_ms_[stage], share);
+    if (allowed == INT_MAX)
+        return;
+    int dropped = capCandidates(vecBbox, allowed, INT_MAX, cap_counters_.deadline);
+    if (dropped > 0) {
+        stats_.capped_boxes += dropped;
+        stats_.deadline_hit = true;
+        stats_.completeness *= (float)allowed / (allowed + dropped);
+    }
+}
+
+// running cost of one crop of a refinement stage
+void MTCNN::updateCropCost(int stage, float stage_ms, int crops){
+    if (crops <= 0)
+        return;
+    float ms = stage_ms / crops;
+    crop_ms_[stage] = crop_ms_[stage] > 0 ? 0.8f * crop_ms_[stage] + 0.2f * ms : ms;
+}
+
+// time since the frame was handed to detect
+float MTCNN::elapsedMs() const {
+    struct timeval start = frame_tv_, tv;
+    gettimeofday(&tv, NULL);
+    return getElapse(&start, &tv);
+}
+
+/*
+ * candidates a refinement stage can evaluate in its share of the time left
+ * to the deadline, at crop_ms per candidate; unbounded without a deadline
+ * or before the crop cost is known
+ */
+int MTCNN::deadlineCandidates(float crop_ms, float share) const {
+    if (params_.deadline_ms <= 0 || crop_ms <= 0)
+        return INT_MAX;
+    float left = (params_.deadline_ms - elapsedMs()) * share;
+    return std::max(1, (int)(left / crop_ms));
+}
+
+/*
+ * mark the cells above the pre-threshold on coarse_mask_, each as its 12x12
+ * window grown by one window on every side so smaller faces next to a hit
+ * are scanned too
+ */
+void MTCNN::markCoarseHits(const ncnn::Mat& score, const ScoreWindow& window, float scale){
+    const int stride = 2, cellsize = 12;
+    const float m = (float)coarse_mask_.cols / img_w;
+    const float *p = score.channel(1);
+    for(int row=window.row;row<window.row+window.rows;row++){
+        for(int col=window.col;col<window.col+window.cols;col++){
+            if(p[row*score.w + col] <= coarse_to_fine_.pre_threshold)
+                continue;
+            float x = (stride*col + window.dx - cellsize) / scale;
+            float y = (stride*row + window.dy - cellsize) / scale;
+            float side = 3 * cellsize / scale;
+            cv::rectangle(coarse_mask_, cv::Point((int)floor(x * m), (int)floor(y * m)),
+                          cv::Point((int)ceil((x + side) * m), (int)ceil((y + side) * m)), cv::Scalar(255), cv::FILLED);
+        }
+    }
+}
+
+// the marked areas of coarse_mask_ in image coordinates
+void MTCNN::findCoarseRegions(){
+    coarse_regions_.clear();
+    coarse_mask_.copyTo(coarse_contour_mask_);
+    cv::findContours(coarse_contour_mask_, coarse_contours_, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    const float m = (float)img_w / coarse_mask_.cols;
+    for (size_t i = 0; i < coarse_contours_.size(); i++) {
+        cv::Rect r = cv::boundingRect(coarse_contours_[i]);
+        coarse_regions_.push_back(cv::Rect(r.x * m, r.y * m, ceil(r.width * m), ceil(r.height * m)));
+    }
+    stats_.coarse_regions = coarse_regions_.size();
+}
+
+/*
+ * Split the scan windows of a level wider or higher than pnet_tile_size_
+ * into tiles PNet can run on in parallel. A tile owns the 12x12 windows that
+ * start in its part of the scan window and reaches 10 pixels into the next
+ * part so its last windows are complete; the stride 2 grid of the scan window
+ * is kept, so every window is scanned by exactly one tile and the candidates
+ * along the seams are the ones of the untiled scan.
+ */
+void MTCNN::tileWindows(const std::vector<cv::Rect>& windows, std::vector<PNetTile>& tiles){
+    const int cellsize = 12, stride = 2;
+    tiles.clear();
+    for (size_t i = 0; i < windows.size(); i++) {
+        const cv::Rect& w = windows[i];
+        int nx = 1, ny = 1;
+        if (pnet_tile_size_ > 0 && num_threads_ > 1) {
+            nx = (w.width + pnet_tile_size_ - 1) / pnet_tile_size_;
+            ny = (w.height + pnet_tile_size_ - 1) / pnet_tile_size_;
+        }
+        // owned part of a tile, on even pixels
+        const int ow = ((w.width + nx - 1) / nx + 1) & ~1, oh = ((w.height + ny - 1) / ny + 1) & ~1;
+        for (int ty = 0; ty < ny; ty++) {
+            for (int tx = 0; tx < nx; tx++) {
+                int x1 = w.x + tx * ow, y1 = w.y + ty * oh;
+                if (x1 >= w.x + w.width || y1 >= w.y + w.height)
+                    continue;
+                int x2 = tx + 1 < nx ? std::min(x1 + ow + cellsize - stride, w.x + w.width) : w.x + w.width;
+                int y2 = ty + 1 < ny ? std::min(y1 + oh + cellsize - stride, w.y + w.height) : w.y + w.height;
+                if (x2 - x1 < cellsize || y2 - y1 < cellsize)
+                    continue;
+                PNetTile tile;
+                tile.input = cv::Rect(x1, y1, x2 - x1, y2 - y1);
+                tile.cols = tx + 1 < nx ? ow / stride : INT_MAX;
+                tile.rows = ty + 1 < ny ? oh / stride : INT_MAX;
+                tiles.push_back(tile);
+            }
+        }
+    }
+}
+
+/*
+ * parts of a pyramid level PNet has to scan: the whole level, or the
+ * regions grown by one 12x12 window on every side. Windows start
+ * on even pixels to keep the stride 2 grid of the whole level, and a level
+ * that is mostly covered is scanned whole. Only the rows of the size bands
+ * of the scale are kept.
+ */
+void MTCNN::scanWindows(int scale_index, const std::vector<cv::Rect>& regions, std::vector<cv::Rect>& windows){
+    const ncnn::Mat& level = pyramid_.scaleLevel(scale_index);
+    const float scale = scales_[scale_index];
+    const cv::Rect bounds(0, 0, level.w, level.h);
+    const int cellsize = 12;
+    windows.clear();
+
+    long area = 0;
+    for (size_t i = 0; i < regions.size(); i++) {
+        const cv::Rect& region = regions[i];
+        int x1 = ((int)floor(region.x * scale) - cellsize) & ~1;
+        int y1 = ((int)floor(region.y * scale) - cellsize) & ~1;
+        int x2 = (int)ceil((region.x + region.width) * scale) + cellsize;
+        int y2 = (int)ceil((region.y + region.height) * scale) + cellsize;
+        cv::Rect window = cv::Rect(x1, y1, x2 - x1, y2 - y1) & bounds;
+        if (window.width < cellsize || window.height < cellsize)
+            continue;
+        windows.push_back(window);
+        area += window.area();
+    }
+
+    if (regions.empty() || area * 10 >= (long)bounds.area() * 6) {
+        windows.clear();
+        windows.push_back(bounds);
+    }
+
+    if (params_.size_bands.empty())
+        return;
+    scanRows(scale_index, scan_rows_);
+    const size_t count = windows.size();
+    for (size_t i = 0; i < count; i++) {
+        for (size_t k = 0; k < scan_rows_.size(); k++) {
+            cv::Rect window = windows[i] & cv::Rect(0, scan_rows_[k].start, level.w, scan_rows_[k].size());
+            if (window.width >= cellsize && window.height >= cellsize)
+                windows.push_back(window);
+        }
+    }
+    windows.erase(windows.begin(), windows.begin() + count);
+}
+
+/*
+ * rows of a pyramid level holding the size bands where a face of the scale's
+ * size is expected, merged and on even pixels. A scale detects faces from
+ * 12 / scale to the size of the next scale, the last one any larger face.
+ */
+void MTCNN::scanRows(int scale_index, std::vector<cv::Range>& rows){
+    const ncnn::Mat& level = pyramid_.scaleLevel(scale_index);
+    const float scale = scales_[scale_index];
+    const float factor = scale_index + 1 < (int)scales_.size() ? scales_[scale_index + 1] / scale : 0;
+    const float min_side = 12 / scale;
+    const float max_side = factor > 0 ? min_side / factor : FLT_MAX;
+    const int cellsize = 12;
+
+    rows.clear();
+    for (size_t i = 0; i < params_.size_bands.size(); i++) {
+        const FaceSizeBand& band = params_.size_bands[i];
+        if (band.max_size < min_side || band.min_size >= max_side)
+            continue;
+        // a face centered in the band reaches half a window out of it
+        int y1 = std::max(0, ((int)floor(band.y1 * scale) - cellsize / 2) & ~1);
+        int y2 = std::min(level.h, (int)ceil(band.y2 * scale) + cellsize / 2);
+        if (!rows.empty() && y1 <= rows.back().end)
+            rows.back().end = std::max(rows.back().end, y2);
+        else if (y2 > y1)
+            rows.push_back(cv::Range(y1, y2));
+    }
+}
+
+/*
+ * PNet once over a mosaic of all pyramid scales.
+ *
+ * The largest scale fills the first column, the following ones are stacked top
+ * to bottom in the next columns. Scales start on even pixels so the stride 2
+ * output grid lines up with every scale, and only the cells whose 12x12 window
+ * lies completely inside a scale are mapped back to it.
+ */
+void MTCNN::runPNetMosaic(const vector<float>& scales_){
+    if(scales_.empty())
+        return;
+
+    const int n = scales_.size();
+    std::vector<cv::Rect>& layout = mosaic_layout_;
+    layout.resize(n);
+    int height = (int)ceil(img_h*scales_[0]);
+    int x = 0, y = 0, column_w = 0;
+    for(int i = 0; i < n; i++){
+        int hs = (int)ceil(img_h*scales_[i]);
+        int ws = (int)ceil(img_w*scales_[i]);
+        if(y + hs > height){
+            x += column_w;
+            y = 0;
+            column_w = 0;
+        }
+        layout[i] = cv::Rect(x, y, ws, hs);
+        y += (hs + 1) & ~1;
+        column_w = std::max(column_w, (ws + 1) & ~1);
+    }
+    int width = x + column_w;
+
+    ncnn::Mat mosaic(width, height, 3, (size_t)4u, blob_pool_);
+    mosaic.fill(0.f);
+    for(int i = 0; i < n; i++){
+        const ncnn::Mat& in = pyramid_.scaleLevel(i);
+        const cv::Rect& r = layout[i];
+        for(int q = 0; q < 3; q++){
+            const float *src = in.channel(q);
+            float *dst = mosaic.channel(q);
+            for(int row = 0; row < r.height; row++)
+                memcpy(dst + (r.y + row) * width + r.x, src + row * r.width, r.width * sizeof(float));
+        }
+    }
 
-    img = img_;
-    img_w = img.w;
-    img_h = img.h;
-    img.substract_mean_normalize(mean_vals, norm_vals);
+    ncnn::Mat score_, location_;
+    backend_->runPNet(mosaic, score_, location_);
+
+    for(int i = 0; i < n; i++){
+        const cv::Rect& r = layout[i];
+        if(r.width < 12 || r.height < 12)
+            continue;
+        ScoreWindow window;
+        window.col = r.x / 2;
+        window.row = r.y / 2;
+        window.cols = std::min((r.width - 12) / 2 + 1, score_.w - window.col);
+        window.rows = std::min((r.height - 12) / 2 + 1, score_.h - window.row);
+        window.dx = -r.x;
+        window.dy = -r.y;
+        generateBbox(score_, location_, scaleBbox_, scales_[i], window);
+        appendScaleBbox(i);
+    }
+    stats_.pnet_area = 1;
+}
 
+// pyramid scales for the current image size
+void MTCNN::computeScales(){
+    scales_.clear();
     float minl = img_w<img_h?img_w:img_h;
     int MIN_DET_SIZE = 12;
     int minsize = 80;
@@ -206,7 +722,6 @@ void MTCNN::detect(ncnn::Mat& img_, std::vector<Bbox>& finalBbox_) {
     minl *= m;
     float factor = 0.709;
     int factor_count = 0;
-    vector<float> scales_;
     while(minl>MIN_DET_SIZE){
         if(factor_count>0)m = m*factor;
         scales_.push_back(m);
@@ -219,125 +734,257 @@ void MTCNN::detect(ncnn::Mat& img_, std::vector<Bbox>& finalBbox_) {
         std::cout << *it << std::endl;
     }
     #endif
+}
 
-    orderScore order;
-    int count = 0;
+void MTCNN::detect(ncnn::Mat& img_, std::vector<Bbox>& finalBbox_, const DetectParams& params) {
+    params_ = params;
+    detection_factor_x_ = detection_factor_y_ = 1;
+    gettimeofday(&frame_tv_, NULL);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+
+    img_w = img_.w;
+    img_h = img_.h;
+    img_.substract_mean_normalize(mean_vals, norm_vals);
+    computeScales();
+    pyramid_.build(img_, scales_);
+
+    gettimeofday(&tv2, NULL);
+    detectPyramid(finalBbox_);
+    pyramid_.clear();
+    stats_.pyramid_ms = getElapse(&tv1, &tv2);
+}
 
-    for (size_t i = 0; i < scales_.size(); i++) {
-        int hs = (int)ceil(img_h*scales_[i]);
-        int ws = (int)ceil(img_w*scales_[i]);
-        ncnn::Mat in;
-        resize_bilinear(img_, in, ws, hs);
-
-        ncnn::Extractor ex = pnet_.create_extractor();
-        ex.set_light_mode(true);
-        ex.input("data", in);
-        ncnn::Mat score_, location_;
-        ex.extract("prob1", score_);
-        ex.extract("conv4-2", location_);
-        
-        std::vector<Bbox> boundingBox_;
-        std::vector<orderScore> bboxScore_;
-        generateBbox(score_, location_, boundingBox_, bboxScore_, scales_[i]);
-        nms(boundingBox_, bboxScore_, nms_threshold[0]);
-
-        for(vector<Bbox>::iterator it=boundingBox_.begin(); it!=boundingBox_.end();it++){
-            if((*it).exist){
-                firstBbox_.push_back(*it);
-                order.score = (*it).score;
-                order.oriOrder = count;
-                firstOrderScore_.push_back(order);
-                count++;
-            }
-        }
-        bboxScore_.clear();
-        boundingBox_.clear();
+void MTCNN::detect(const cv::Mat& frame, std::vector<Bbox>& finalBbox_, const DetectParams& params) {
+    params_ = params;
+    beginFrame(frame);
+    detectPyramid(finalBbox_);
+    endFrame(frame, finalBbox_);
+}
+
+/*
+ * pyramid_ of the frame at the detection width of params_, whose regions and
+ * size bands are moved to the detection image
+ */
+void MTCNN::beginFrame(const cv::Mat& frame) {
+    gettimeofday(&frame_tv_, NULL);
+    detection_factor_x_ = detection_factor_y_ = 1;
+    if (params_.detection_width <= 0 || params_.detection_width >= frame.cols) {
+        buildPyramid(frame);
+        return;
+    }
+
+    const float s = (float)params_.detection_width / frame.cols;
+    cv::resize(frame, detection_frame_, cv::Size(params_.detection_width, std::max(1, (int)round(frame.rows * s))), 0, 0, cv::INTER_AREA);
+    // the rounded height makes the vertical factor differ slightly
+    detection_factor_x_ = (float)frame.cols / detection_frame_.cols;
+    detection_factor_y_ = (float)frame.rows / detection_frame_.rows;
+    for (size_t i = 0; i < params_.regions.size(); i++) {
+        cv::Rect& r = params_.regions[i];
+        r = cv::Rect((int)floor(r.x * s), (int)floor(r.y * s), (int)ceil(r.width * s), (int)ceil(r.height * s));
+    }
+    for (size_t i = 0; i < params_.size_bands.size(); i++) {
+        FaceSizeBand& band = params_.size_bands[i];
+        band.y1 = (int)floor(band.y1 * s);
+        band.y2 = (int)ceil(band.y2 * s);
+        band.min_size *= s;
+        band.max_size = band.max_size < FLT_MAX ? band.max_size * s : FLT_MAX;
+    }
+    buildPyramid(detection_frame_);
+}
+
+// faces of the detection image back to the frame
+void MTCNN::endFrame(const cv::Mat& frame, std::vector<Bbox>& finalBbox_) {
+    pyramid_.clear();
+    if (detection_factor_x_ == 1 && detection_factor_y_ == 1)
+        return;
+    for (size_t i = 0; i < finalBbox_.size(); i++) {
+        Bbox& box = finalBbox_[i];
+        box.scale(detection_factor_x_, detection_factor_y_);
+        box.x1 = std::max(box.x1, 0);
+        box.y1 = std::max(box.y1, 0);
+        box.x2 = std::min(box.x2, frame.cols);
+        box.y2 = std::min(box.y2, frame.rows);
     }
-    
+    if (params_.refine_landmarks && backend_)
+        refineLandmarks(frame, finalBbox_);
+}
+
+// pyramid_ of a BGR frame, sets pyramid_ms
+void MTCNN::buildPyramid(const cv::Mat& frame) {
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+
+    img_w = frame.cols;
+    img_h = frame.rows;
+    computeScales();
+    pyramid_.build(frame, scales_, mean_vals, norm_vals);
+
+    gettimeofday(&tv2, NULL);
+    stats_.pyramid_ms = getElapse(&tv1, &tv2);
+}
+
+/*
+ * The three stages over pyramid_. Each refinement stage is split in the
+ * evaluation of its network and the acceptance of its outputs, so that
+ * DetectionService can evaluate the stages of several frames as one batch.
+ */
+void MTCNN::detectPyramid(std::vector<Bbox>& finalBbox_) {
+    if(!firstStage())
+        return;
+    evaluateStage(STAGE_RNET);
+    if(!acceptRNet())
+        return;
+    evaluateStage(STAGE_ONET);
+    acceptONet(finalBbox_);
+}
+
+// PNet, nms and the RNet candidate limits, false when no candidate is left
+bool MTCNN::firstStage() {
+    firstBbox_.clear();
+    secondBbox_.clear();
+    thirdBbox_.clear();
+    float pyramid_ms = stats_.pyramid_ms;
+    stats_ = DetectStats();
+    stats_.pyramid_ms = pyramid_ms;
+    stats_.completeness = 1;
+    if(!backend_)
+        return false;
+    cap_counters_.frames++;
+
+    const int rnet_topk = limits_.rnet_topk > 0 ? limits_.rnet_topk : INT_MAX;
+    // one crop per refinement stage at least
+    budget_ = limits_.frame_budget > 0 ? std::max(2, limits_.frame_budget) : INT_MAX;
+
+    struct timeval tv;
+    gettimeofday(&stage_tv_, NULL);
+
+    scale_active_.clear();
+    if (params_.scale_history && params_.scale_history->begin(scales_.size(), scale_active_)) {
+        for (size_t i = 0; i < scale_active_.size(); i++)
+            stats_.skipped_scales += !scale_active_[i];
+    }
+
+    if (pnet_mosaic_ && !coarse_to_fine_.enable && params_.regions.empty() && params_.size_bands.empty() && stats_.skipped_scales == 0)
+        runPNetMosaic(scales_);
+    else
+        runPNet(scales_);
+
     //the first stage's nms
-    if(count<1)return;
-    nms(firstBbox_, firstOrderScore_, nms_threshold[0]);
-    refineAndSquareBbox(firstBbox_, img_h, img_w);
-    // std::cout << "firstBbox_.size() = " << firstBbox_.size() << std::endl;
+    if(!firstBbox_.empty()){
+        nms(firstBbox_, nms_threshold[0]);
+        refineAndSquareBbox(firstBbox_, img_h, img_w);
+        // RNet leaves at least a quarter of the frame budget to ONet
+        const int rnet_budget = budget_ != INT_MAX ? budget_ - std::max(1, budget_ / 4) : INT_MAX;
+        stats_.capped_boxes += capCandidates(firstBbox_, rnet_topk, rnet_budget, cap_counters_.rnet_topk);
+        // half of the time left goes to RNet, the other half to ONet
+        capDeadline(firstBbox_, STAGE_RNET, 0.5f);
+        // std::cout << "firstBbox_.size() = " << firstBbox_.size() << std::endl;
+    }
 
-    //second stage
-    count = 0;
+    gettimeofday(&tv, NULL);
+    stats_.pnet_ms = getElapse(&stage_tv_, &tv);
+    stage_tv_ = tv;
     for(vector<Bbox>::iterator it=firstBbox_.begin(); it!=firstBbox_.end();it++){
+        if((*it).exist)
+            stats_.pnet_boxes++;
+    }
+    if(budget_ != INT_MAX)
+        budget_ -= stats_.pnet_boxes;
+    return stats_.pnet_boxes > 0;
+}
+
+// network outputs of a refinement stage into stage_out_
+void MTCNN::evaluateStage(int stage) {
+    if (batch_stages_) {
+        MTCNN *self = this;
+        runStageBatch(&self, 1, stage);
+    }
+    else
+        runStage(stage);
+}
+
+// RNet outputs, nms and the ONet candidate limits, false when no candidate is left
+bool MTCNN::acceptRNet() {
+    const int onet_topk = limits_.onet_topk > 0 ? limits_.onet_topk : INT_MAX;
+
+    int count = 0;
+    for(size_t i = 0; i < firstBbox_.size(); i++){
+        vector<Bbox>::iterator it = firstBbox_.begin() + i;
         if((*it).exist){
-            ncnn::Mat tempIm;            
-            copy_cut_border(img, tempIm, (*it).y1, img_h-(*it).y2, (*it).x1, img_w-(*it).x2);
-
-            ncnn::Mat in;
-            resize_bilinear(tempIm, in, 24, 24);
-
-            ncnn::Extractor ex = rnet_.create_extractor();
-            ex.set_light_mode(true);
-            ex.input("data", in);
-            ncnn::Mat score, bbox;
-            ex.extract("prob1", score);
-            ex.extract("conv5-2", bbox);
-            // if(score.channel(1)[0]>threshold[1]){
-            if(score[1]>threshold[1]){                
+            const float *out = &stage_out_[i * STAGE_OUTPUT_SIZE];
+            if(out[0]>threshold[1]){
                 for(int channel=0;channel<4;channel++)
-                    it->regreCoord[channel]=bbox[channel];
+                    it->regreCoord[channel]=out[1+channel];
                 it->area = (it->x2 - it->x1)*(it->y2 - it->y1);
-                it->score = score[1];//*(score.data+score.cstep);
+                it->score = out[0];
                 secondBbox_.push_back(*it);
-                order.score = it->score;
-                order.oriOrder = count++;
-                secondBboxScore_.push_back(order);
+                count++;
             }
             else{
                 (*it).exist=false;
             }
         }
     }
-    //std::cout << "secondBbox_.size() = " << secondBbox_.size() << std::endl;    
-    if(count<1)return;
-    nms(secondBbox_, secondBboxScore_, nms_threshold[1]);
+    //std::cout << "secondBbox_.size() = " << secondBbox_.size() << std::endl;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    stats_.rnet_ms = getElapse(&stage_tv_, &tv);
+    stage_tv_ = tv;
+    updateCropCost(STAGE_RNET, stats_.rnet_ms, stats_.pnet_boxes);
+    if(count<1)
+        return false;
+    nms(secondBbox_, nms_threshold[1]);
     refineAndSquareBbox(secondBbox_, img_h, img_w);
-
-    //third stage 
-    count = 0;
+    stats_.capped_boxes += capCandidates(secondBbox_, onet_topk, budget_, cap_counters_.onet_topk);
+    capDeadline(secondBbox_, STAGE_ONET, 1.0f);
     for(vector<Bbox>::iterator it=secondBbox_.begin(); it!=secondBbox_.end();it++){
+        if((*it).exist)
+            stats_.rnet_boxes++;
+    }
+    return stats_.rnet_boxes > 0;
+}
+
+// ONet outputs and the final nms
+void MTCNN::acceptONet(std::vector<Bbox>& finalBbox_) {
+    int count = 0;
+    for(size_t i = 0; i < secondBbox_.size(); i++){
+        vector<Bbox>::iterator it = secondBbox_.begin() + i;
         if((*it).exist){
-            ncnn::Mat tempIm;
-            copy_cut_border(img, tempIm, (*it).y1, img_h-(*it).y2, (*it).x1, img_w-(*it).x2);
-            ncnn::Mat in;
-            resize_bilinear(tempIm, in, 48, 48);
-            ncnn::Extractor ex = onet_.create_extractor();
-            ex.set_light_mode(true);
-
-            ex.input("data", in);
-            ncnn::Mat score, bbox, keyPoint;
-            ex.extract("prob1", score);
-            ex.extract("conv6-2", bbox);
-            ex.extract("conv6-3", keyPoint);      
-            if(score[1]>threshold[2]){
+            const float *out = &stage_out_[i * STAGE_OUTPUT_SIZE];
+            if(out[0]>threshold[2]){
                 for(int channel=0;channel<4;channel++)
-                    it->regreCoord[channel]=bbox[channel];
+                    it->regreCoord[channel]=out[1+channel];
                 it->area = (it->x2 - it->x1)*(it->y2 - it->y1);
-                it->score = score[1];
+                it->score = out[0];
+                const float *keyPoint = out + 5;
                 for(int num=0;num<5;num++){
                     (it->ppoint)[num] = it->x1 + (it->x2 - it->x1)*keyPoint[num];
                     (it->ppoint)[num+5] = it->y1 + (it->y2 - it->y1)*keyPoint[num+5];
                 }
 
                 thirdBbox_.push_back(*it);
-                order.score = it->score;
-                order.oriOrder = count++;
-                thirdBboxScore_.push_back(order);
+                count++;
             }
             else
                 (*it).exist=false;
-            }
         }
+    }
 
     //std::cout << "thirdBbox_.size() = " << thirdBbox_.size() << std::endl;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    stats_.onet_ms = getElapse(&stage_tv_, &tv);
+    updateCropCost(STAGE_ONET, stats_.onet_ms, stats_.rnet_boxes);
     if(count < 1)
         return;
     refineAndSquareBbox(thirdBbox_, img_h, img_w);
-    nms(thirdBbox_, thirdBboxScore_, nms_threshold[2], "Min");
+    nms(thirdBbox_, nms_threshold[2], NMS_MIN);
     finalBbox_ = thirdBbox_;
+    for(vector<Bbox>::iterator it=thirdBbox_.begin(); it!=thirdBbox_.end();it++){
+        if((*it).exist)
+            stats_.onet_boxes++;
+    }
+    if(params_.scale_history)
+        params_.scale_history->record(thirdBbox_);
 }
-
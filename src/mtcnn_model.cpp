@@ -0,0 +1,75 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include "mtcnn_model.h"
+
+MTCNNModel::~MTCNNModel() {
+    // drop the layers before unmapping the weights they point to
+    pnet.clear();
+    rnet.clear();
+    onet.clear();
+    for (size_t i = 0; i < mappings_.size(); i++)
+        munmap(mappings_[i].addr, mappings_[i].length);
+}
+
+std::shared_ptr<const MTCNNModel> MTCNNModel::load(const std::string& model_path, bool int8, bool mapped) {
+    // the int8 set is written next to the fp32 one by the calibrate tool
+    std::string prefix = model_path + "/det";
+    std::string suffix = int8 ? "-int8" : "";
+
+    std::shared_ptr<MTCNNModel> model(new MTCNNModel());
+    if (!model->loadNet(model->pnet, prefix + "1" + suffix + ".param", prefix + "1" + suffix + ".bin", mapped) ||
+        !model->loadNet(model->rnet, prefix + "2" + suffix + ".param", prefix + "2" + suffix + ".bin", mapped) ||
+        !model->loadNet(model->onet, prefix + "3" + suffix + ".param", prefix + "3" + suffix + ".bin", mapped))
+        return std::shared_ptr<const MTCNNModel>();
+    return model;
+}
+
+bool MTCNNModel::loadNet(ncnn::Net& net, const std::string& param_file, const std::string& bin_file, bool mapped) {
+    if (net.load_param(param_file.c_str()) != 0) {
+        std::cerr << "failed to load " << param_file << std::endl;
+        return false;
+    }
+    if (!mapped)
+        return readNet(net, bin_file);
+
+    int fd = open(bin_file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "failed to open " << bin_file << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "failed to stat " << bin_file << std::endl;
+        close(fd);
+        return false;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "failed to map " << bin_file << ", reading it instead" << std::endl;
+        return readNet(net, bin_file);
+    }
+
+    Mapping mapping = {addr, (size_t)st.st_size};
+    mappings_.push_back(mapping);
+    // the weights of the param file must take the whole file, anything else is another model
+    size_t consumed = net.load_model((const unsigned char*)addr);
+    if (consumed != (size_t)st.st_size) {
+        std::cerr << "failed to load " << bin_file << ": " << consumed << " of " << st.st_size << " bytes used" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MTCNNModel::readNet(ncnn::Net& net, const std::string& bin_file) {
+    if (net.load_model(bin_file.c_str()) != 0) {
+        std::cerr << "failed to load " << bin_file << std::endl;
+        return false;
+    }
+    return true;
+}
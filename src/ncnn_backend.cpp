@@ -0,0 +1,80 @@
+#include "ncnn_backend.h"
+
+// output blobs of RNet and ONet
+static const struct {
+    const char *bbox_blob;
+    const char *point_blob;
+} STAGE_BLOBS[2] = {
+    {"conv5-2", NULL},
+    {"conv6-2", "conv6-3"},
+};
+
+NcnnBackend::NcnnBackend(std::shared_ptr<const MTCNNModel> model, int num_threads, bool light_mode,
+                         ncnn::Allocator* blob_allocator, ncnn::Allocator* workspace_allocator)
+    : model_(model), num_threads_(num_threads), light_mode_(light_mode),
+      blob_allocator_(blob_allocator), workspace_allocator_(workspace_allocator) {
+}
+
+/*
+ * extractor with the blob and workspace allocators of the detector. ncnn
+ * extractors keep the blobs of their input, so a fresh one is needed per input.
+ */
+ncnn::Extractor NcnnBackend::newExtractor(const ncnn::Net& net, int num_threads) {
+    ncnn::Extractor ex = net.create_extractor();
+    ex.set_light_mode(light_mode_);
+    ex.set_num_threads(num_threads);
+    ex.set_blob_allocator(blob_allocator_);
+    ex.set_workspace_allocator(workspace_allocator_);
+    return ex;
+}
+
+void NcnnBackend::runPNet(const ncnn::Mat& in, ncnn::Mat& score, ncnn::Mat& location) {
+    runPNet(in, num_threads_, score, location);
+}
+
+void NcnnBackend::runPNet(const ncnn::Mat& in, int num_threads, ncnn::Mat& score, ncnn::Mat& location) {
+    ncnn::Extractor ex = newExtractor(model_->pnet, num_threads);
+    ex.input("data", in);
+    ex.extract("prob1", score);
+    ex.extract("conv4-2", location);
+}
+
+// tiles are taken by the threads as they get free, so uneven tiles balance out
+void NcnnBackend::runPNetTiles(const ncnn::Mat* in, int n, ncnn::Mat* score, ncnn::Mat* location) {
+    if (n == 1) {
+        runPNet(in[0], num_threads_, score[0], location[0]);
+        return;
+    }
+
+    #pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (int k = 0; k < n; k++)
+        runPNet(in[k], 1, score[k], location[k]);
+}
+
+void NcnnBackend::runCrop(int stage, const ncnn::Mat& in, int num_threads, float* out) {
+    ncnn::Extractor ex = newExtractor(stage == STAGE_RNET ? model_->rnet : model_->onet, num_threads);
+    ex.input("data", in);
+    ncnn::Mat score, bbox, keyPoint;
+    ex.extract("prob1", score);
+    ex.extract(STAGE_BLOBS[stage].bbox_blob, bbox);
+
+    out[0] = score[1];
+    for (int channel = 0; channel < 4; channel++)
+        out[1 + channel] = bbox[channel];
+    if (STAGE_BLOBS[stage].point_blob) {
+        ex.extract(STAGE_BLOBS[stage].point_blob, keyPoint);
+        for (int num = 0; num < 10; num++)
+            out[5 + num] = keyPoint[num];
+    }
+}
+
+void NcnnBackend::runStage(int stage, const ncnn::Mat& crops, int n, float* out) {
+    if (n == 1) {
+        runCrop(stage, crops, num_threads_, out);
+        return;
+    }
+
+    #pragma omp parallel for num_threads(num_threads_)
+    for (int k = 0; k < n; k++)
+        runCrop(stage, crops.channel_range(3 * k, 3), 1, out + k * STAGE_OUTPUT_SIZE);
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include "nms.h"
+
+#if __ARM_NEON && __aarch64__
+#include <arm_neon.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct ScoreGreater {
+    const float *score;
+    bool operator()(int lhs, int rhs) const { return score[lhs] > score[rhs]; }
+};
+
+/*
+ * overlap of box b against boxes [0, n), written to iou
+ * same measure as the original MTCNN nms: the intersection counts the border
+ * pixels (+1) while the areas do not.
+ */
+void overlap(const BoxArray& boxes, int begin, int n, int b, NmsMode mode, float* iou) {
+    const float *x1 = boxes.x1.data() + begin;
+    const float *y1 = boxes.y1.data() + begin;
+    const float *x2 = boxes.x2.data() + begin;
+    const float *y2 = boxes.y2.data() + begin;
+    const float *area = boxes.area.data() + begin;
+    const float bx1 = boxes.x1[b];
+    const float by1 = boxes.y1[b];
+    const float bx2 = boxes.x2[b];
+    const float by2 = boxes.y2[b];
+    const float barea = boxes.area[b];
+
+    int i = 0;
+#if __ARM_NEON && __aarch64__
+    float32x4_t _bx1 = vdupq_n_f32(bx1);
+    float32x4_t _by1 = vdupq_n_f32(by1);
+    float32x4_t _bx2 = vdupq_n_f32(bx2);
+    float32x4_t _by2 = vdupq_n_f32(by2);
+    float32x4_t _barea = vdupq_n_f32(barea);
+    float32x4_t _one = vdupq_n_f32(1.f);
+    float32x4_t _zero = vdupq_n_f32(0.f);
+    for (; i + 3 < n; i += 4) {
+        float32x4_t _w = vsubq_f32(vminq_f32(vld1q_f32(x2 + i), _bx2), vmaxq_f32(vld1q_f32(x1 + i), _bx1));
+        float32x4_t _h = vsubq_f32(vminq_f32(vld1q_f32(y2 + i), _by2), vmaxq_f32(vld1q_f32(y1 + i), _by1));
+        _w = vmaxq_f32(vaddq_f32(_w, _one), _zero);
+        _h = vmaxq_f32(vaddq_f32(_h, _one), _zero);
+        float32x4_t _inter = vmulq_f32(_w, _h);
+        float32x4_t _area = vld1q_f32(area + i);
+        float32x4_t _denom = mode == NMS_UNION ? vsubq_f32(vaddq_f32(_area, _barea), _inter) : vminq_f32(_area, _barea);
+        vst1q_f32(iou + i, vdivq_f32(_inter, _denom));
+    }
+#elif __SSE2__
+    __m128 _bx1 = _mm_set1_ps(bx1);
+    __m128 _by1 = _mm_set1_ps(by1);
+    __m128 _bx2 = _mm_set1_ps(bx2);
+    __m128 _by2 = _mm_set1_ps(by2);
+    __m128 _barea = _mm_set1_ps(barea);
+    __m128 _one = _mm_set1_ps(1.f);
+    __m128 _zero = _mm_setzero_ps();
+    for (; i + 3 < n; i += 4) {
+        __m128 _w = _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(x2 + i), _bx2), _mm_max_ps(_mm_loadu_ps(x1 + i), _bx1));
+        __m128 _h = _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(y2 + i), _by2), _mm_max_ps(_mm_loadu_ps(y1 + i), _by1));
+        _w = _mm_max_ps(_mm_add_ps(_w, _one), _zero);
+        _h = _mm_max_ps(_mm_add_ps(_h, _one), _zero);
+        __m128 _inter = _mm_mul_ps(_w, _h);
+        __m128 _area = _mm_loadu_ps(area + i);
+        __m128 _denom = mode == NMS_UNION ? _mm_sub_ps(_mm_add_ps(_area, _barea), _inter) : _mm_min_ps(_area, _barea);
+        _mm_storeu_ps(iou + i, _mm_div_ps(_inter, _denom));
+    }
+#endif
+    for (; i < n; i++) {
+        float w = std::min(x2[i], bx2) - std::max(x1[i], bx1) + 1;
+        float h = std::min(y2[i], by2) - std::max(y1[i], by1) + 1;
+        w = w > 0 ? w : 0;
+        h = h > 0 ? h : 0;
+        float inter = w * h;
+        float denom = mode == NMS_UNION ? area[i] + barea - inter : std::min(area[i], barea);
+        iou[i] = inter / denom;
+    }
+}
+
+}
+
+void NmsEngine::run(const BoxArray& boxes, float overlap_threshold, NmsMode mode, std::vector<int>& keep) {
+    keep.clear();
+    const int n = boxes.size();
+    if (n == 0) {
+        return;
+    }
+
+    // one sort, highest score first
+    order_.resize(n);
+    for (int i = 0; i < n; i++) {
+        order_[i] = i;
+    }
+    ScoreGreater cmp = { &boxes.score[0] };
+    std::stable_sort(order_.begin(), order_.end(), cmp);
+
+    sorted_.clear();
+    sorted_.reserve(n);
+    for (int i = 0; i < n; i++) {
+        int k = order_[i];
+        sorted_.push_back(boxes.x1[k], boxes.y1[k], boxes.x2[k], boxes.y2[k], boxes.area[k], boxes.score[k]);
+    }
+    iou_.resize(n);
+
+    // candidates [head, count) are still alive, in score order
+    int count = n;
+    for (int head = 0; head < count; head++) {
+        keep.push_back(order_[head]);
+
+        int rest = count - head - 1;
+        overlap(sorted_, head + 1, rest, head, mode, &iou_[0]);
+
+        // compact the survivors right behind the kept box
+        int alive = head + 1;
+        for (int i = 0; i < rest; i++) {
+            if (iou_[i] > overlap_threshold) {
+                continue;
+            }
+            int from = head + 1 + i;
+            if (from != alive) {
+                sorted_.x1[alive] = sorted_.x1[from];
+                sorted_.y1[alive] = sorted_.y1[from];
+                sorted_.x2[alive] = sorted_.x2[from];
+                sorted_.y2[alive] = sorted_.y2[from];
+                sorted_.area[alive] = sorted_.area[from];
+                order_[alive] = order_[from];
+            }
+            alive++;
+        }
+        count = alive;
+    }
+}
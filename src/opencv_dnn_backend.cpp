@@ -0,0 +1,103 @@
+#include <iostream>
+#include <string.h>
+#include "opencv_dnn_backend.h"
+
+static cv::dnn::Net loadCaffe(const std::string& prefix) {
+    cv::dnn::Net net;
+    try {
+        net = cv::dnn::readNetFromCaffe(prefix + ".prototxt", prefix + ".caffemodel");
+    } catch (const cv::Exception& e) {
+        std::cerr << "failed to load " << prefix << ".prototxt: " << e.what() << std::endl;
+        return net;
+    }
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_DEFAULT);
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    return net;
+}
+
+OpenCVDnnBackend::OpenCVDnnBackend(const std::string& model_path, bool transpose_input)
+    : transpose_(transpose_input) {
+    pnet_ = loadCaffe(model_path + "/det1");
+    rnet_ = loadCaffe(model_path + "/det2");
+    onet_ = loadCaffe(model_path + "/det3");
+}
+
+bool OpenCVDnnBackend::loaded() const {
+    return !pnet_.empty() && !rnet_.empty() && !onet_.empty();
+}
+
+// n images of in.c / n planes each into an NCHW blob
+void OpenCVDnnBackend::toBlob(const ncnn::Mat& in, int n, cv::Mat& blob) const {
+    const int w = transpose_ ? in.h : in.w;
+    const int h = transpose_ ? in.w : in.h;
+    int sizes[4] = {n, in.c / n, h, w};
+    blob.create(4, sizes, CV_32F);
+
+    for (int q = 0; q < in.c; q++) {
+        const float *src = in.channel(q);
+        float *dst = blob.ptr<float>() + (size_t)q * w * h;
+        if (!transpose_) {
+            memcpy(dst, src, w * h * sizeof(float));
+            continue;
+        }
+        for (int y = 0; y < in.h; y++) {
+            for (int x = 0; x < in.w; x++)
+                dst[x * w + y] = src[y * in.w + x];
+        }
+    }
+}
+
+// 1 x C x H x W output map into a C plane ncnn::Mat in image orientation
+void OpenCVDnnBackend::fromMap(const cv::Mat& map, ncnn::Mat& out) const {
+    const int c = map.size[1], h = map.size[2], w = map.size[3];
+    const int out_w = transpose_ ? h : w;
+    const int out_h = transpose_ ? w : h;
+    out.create(out_w, out_h, c);
+
+    for (int q = 0; q < c; q++) {
+        const float *src = map.ptr<float>() + (size_t)q * w * h;
+        float *dst = out.channel(q);
+        if (!transpose_) {
+            memcpy(dst, src, w * h * sizeof(float));
+            continue;
+        }
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++)
+                dst[x * out_w + y] = src[y * w + x];
+        }
+    }
+}
+
+void OpenCVDnnBackend::runPNet(const ncnn::Mat& in, ncnn::Mat& score, ncnn::Mat& location) {
+    static const std::vector<cv::String> names = {"prob1", "conv4-2"};
+    toBlob(in, 1, blob_);
+    pnet_.setInput(blob_, "data");
+    pnet_.forward(outs_, names);
+    fromMap(outs_[0], score);
+    fromMap(outs_[1], location);
+}
+
+void OpenCVDnnBackend::runStage(int stage, const ncnn::Mat& crops, int n, float* out) {
+    static const std::vector<cv::String> rnet_names = {"prob1", "conv5-2"};
+    static const std::vector<cv::String> onet_names = {"prob1", "conv6-2", "conv6-3"};
+    cv::dnn::Net& net = stage == STAGE_RNET ? rnet_ : onet_;
+
+    toBlob(crops, n, blob_);
+    net.setInput(blob_, "data");
+    net.forward(outs_, stage == STAGE_RNET ? rnet_names : onet_names);
+
+    // outputs are n x 2, n x 4 and n x 10
+    const float *prob = outs_[0].ptr<float>();
+    const float *bbox = outs_[1].ptr<float>();
+    const float *points = stage == STAGE_ONET ? outs_[2].ptr<float>() : NULL;
+    for (int k = 0; k < n; k++) {
+        float *o = out + k * STAGE_OUTPUT_SIZE;
+        o[0] = prob[2 * k + 1];
+        for (int channel = 0; channel < 4; channel++)
+            o[1 + channel] = bbox[4 * k + channel];
+        if (points) {
+            for (int num = 0; num < 10; num++)
+                o[5 + num] = points[10 * k + num];
+        }
+    }
+}
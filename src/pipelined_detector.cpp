@@ -0,0 +1,142 @@
+#include <algorithm>
+#include "pipelined_detector.h"
+#include "time_utils.h"
+
+void PipelinedDetector::StageQueue::push(Job* job) {
+    std::unique_lock<std::mutex> guard(lock_);
+    changed_.wait(guard, [this] { return jobs_.size() < capacity_; });
+    jobs_.push_back(job);
+    changed_.notify_all();
+}
+
+PipelinedDetector::Job* PipelinedDetector::StageQueue::pop() {
+    std::unique_lock<std::mutex> guard(lock_);
+    changed_.wait(guard, [this] { return closed_ || !jobs_.empty(); });
+    if (jobs_.empty())
+        return NULL;
+    Job *job = jobs_.front();
+    jobs_.pop_front();
+    changed_.notify_all();
+    return job;
+}
+
+void PipelinedDetector::StageQueue::close() {
+    std::lock_guard<std::mutex> guard(lock_);
+    closed_ = true;
+    changed_.notify_all();
+}
+
+PipelinedDetector::PipelinedDetector(std::shared_ptr<const MTCNNModel> model, const MTCNNOptions& options, int queue_size)
+    : stats_(), started_(false) {
+    queue_size = std::max(1, queue_size);
+    // one context per stage at work plus the ones waiting in its queue
+    const int contexts = STAGES * (queue_size + 1);
+    free_.reset(new StageQueue(contexts));
+    for (int i = 0; i < contexts; i++) {
+        detectors_.push_back(std::unique_ptr<MTCNN>(new MTCNN(model, options)));
+        Job *job = new Job();
+        job->detector = detectors_.back().get();
+        free_->push(job);
+    }
+
+    for (int stage = 0; stage < STAGES; stage++)
+        queues_[stage].reset(new StageQueue(queue_size));
+    for (int stage = 0; stage < STAGES; stage++)
+        workers_[stage] = std::thread(&PipelinedDetector::run, this, stage);
+}
+
+PipelinedDetector::~PipelinedDetector() {
+    // each stage drains its queue, then closes the next one
+    queues_[STAGE_PNET]->close();
+    for (int stage = 0; stage < STAGES; stage++)
+        workers_[stage].join();
+
+    free_->close();
+    while (Job *job = free_->pop())
+        delete job;
+}
+
+std::future<std::vector<Bbox> > PipelinedDetector::submit(const cv::Mat& frame, const DetectParams& params) {
+    {
+        std::lock_guard<std::mutex> guard(stats_lock_);
+        if (!started_) {
+            gettimeofday(&start_, NULL);
+            started_ = true;
+        }
+    }
+
+    Job *job = free_->pop();
+    // the capture loop reuses its frame buffer
+    job->frame = frame.clone();
+    job->params = params;
+    job->result = std::promise<std::vector<Bbox> >();
+    job->candidates = true;
+    std::future<std::vector<Bbox> > result = job->result.get_future();
+    queues_[STAGE_PNET]->push(job);
+    return result;
+}
+
+PipelineStats PipelinedDetector::stats() {
+    std::lock_guard<std::mutex> guard(stats_lock_);
+    PipelineStats stats = stats_;
+    if (started_) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        stats.elapsed_ms = getElapse(&start_, &now);
+    }
+    return stats;
+}
+
+void PipelinedDetector::run(int stage) {
+    while (Job *job = queues_[stage]->pop()) {
+        struct timeval start;
+        gettimeofday(&start, NULL);
+        process(stage, job);
+        countBusy(stage, start);
+
+        if (stage + 1 < STAGES)
+            queues_[stage + 1]->push(job);
+        else
+            free_->push(job);
+    }
+    if (stage + 1 < STAGES)
+        queues_[stage + 1]->close();
+}
+
+// one stage of a frame, the stage split of MTCNN::detect
+void PipelinedDetector::process(int stage, Job* job) {
+    MTCNN *detector = job->detector;
+    switch (stage) {
+    case STAGE_PNET:
+        detector->params_ = job->params;
+        detector->beginFrame(job->frame);
+        job->candidates = detector->firstStage();
+        break;
+    case STAGE_RNET:
+        if (job->candidates) {
+            detector->evaluateStage(MTCNN::STAGE_RNET);
+            job->candidates = detector->acceptRNet();
+        }
+        break;
+    case STAGE_ONET: {
+        std::vector<Bbox> faces;
+        if (job->candidates) {
+            detector->evaluateStage(MTCNN::STAGE_ONET);
+            detector->acceptONet(faces);
+        }
+        detector->endFrame(job->frame, faces);
+        job->frame.release();
+        job->result.set_value(faces);
+        break;
+    }
+    }
+}
+
+void PipelinedDetector::countBusy(int stage, const struct timeval& start) {
+    struct timeval begin = start, end;
+    gettimeofday(&end, NULL);
+    std::lock_guard<std::mutex> guard(stats_lock_);
+    stats_.busy_ms[stage] += getElapse(&begin, &end);
+    if (stage == STAGE_ONET)
+        stats_.frames++;
+}
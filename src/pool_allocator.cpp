@@ -0,0 +1,28 @@
+#include "pool_allocator.h"
+
+void* CountingPoolAllocator::fastMalloc(size_t size) {
+    void* ptr = pool_.fastMalloc(size);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (seen_.insert(ptr).second) {
+        heap_allocations_++;
+    }
+    return ptr;
+}
+
+void CountingPoolAllocator::fastFree(void* ptr) {
+    pool_.fastFree(ptr);
+}
+
+size_t CountingPoolAllocator::heapAllocations() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return heap_allocations_;
+}
+
+void CountingPoolAllocator::clear() {
+    std::lock_guard<std::mutex> guard(lock_);
+    pool_.clear();
+    // freed buffers may come back from the heap at the same address
+    seen_.clear();
+    heap_allocations_ = 0;
+}
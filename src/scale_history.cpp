@@ -0,0 +1,52 @@
+#include <algorithm>
+#include "mtcnn.h"
+#include "scale_history.h"
+
+ScaleHistory::ScaleHistory(int window, int sweep_period)
+    : window_(std::max(1, window)), sweep_period_(std::max(1, sweep_period)), stats_() {
+}
+
+bool ScaleHistory::begin(int scales, std::vector<char>& active) {
+    std::lock_guard<std::mutex> guard(lock_);
+    // the scale count follows the frame size, a new size starts over
+    if ((int)last_face_.size() != scales) {
+        last_face_.assign(scales, -1);
+        stats_ = ScaleHistoryStats();
+        stats_.faces.assign(scales, 0);
+        stats_.skipped.assign(scales, 0);
+    }
+
+    long detection = stats_.detections++;
+    active.assign(scales, 1);
+    if (detection < window_ || detection % sweep_period_ == 0) {
+        stats_.sweeps++;
+        return false;
+    }
+
+    for (int i = 0; i < scales; i++) {
+        bool recent = false;
+        for (int k = std::max(0, i - 1); k <= std::min(scales - 1, i + 1); k++)
+            recent = recent || (last_face_[k] >= 0 && detection - last_face_[k] <= window_);
+        if (!recent) {
+            active[i] = 0;
+            stats_.skipped[i]++;
+        }
+    }
+    return true;
+}
+
+void ScaleHistory::record(const std::vector<Bbox>& faces) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < faces.size(); i++) {
+        int level = faces[i].level;
+        if (!faces[i].exist || level < 0 || level >= (int)last_face_.size())
+            continue;
+        last_face_[level] = stats_.detections - 1;
+        stats_.faces[level]++;
+    }
+}
+
+ScaleHistoryStats ScaleHistory::stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
@@ -1,6 +1,7 @@
 #include "camera.h"
 #include <dirent.h>
 #include <face_align.h>
+#include <fstream>
 #include <glog/logging.h>
 #include <iostream>
 #include "mtcnn.h"
@@ -176,3 +177,13 @@ void saveFace(const cv::Mat &frame, const Bbox &box, long faceId, string outputF
 
 //     return 0;
 // }
+
+long get_resident_memory_kb() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return atol(line.c_str() + 6);
+    }
+    return -1;
+}
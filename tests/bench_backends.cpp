@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * ncnn against OpenCV dnn on the same frames: latency per stage and how well
+ * the faces found by the two backends match
+ */
+
+struct BackendTiming {
+    float pyramid_ms, pnet_ms, rnet_ms, onet_ms;
+    int faces;
+};
+
+static void detect(MTCNN &mm, const cv::Mat &frame, vector<Bbox> &faces, BackendTiming &timing) {
+    faces.clear();
+    mm.detect(frame, faces);
+    const DetectStats &stats = mm.stats();
+    timing.pyramid_ms += stats.pyramid_ms;
+    timing.pnet_ms += stats.pnet_ms;
+    timing.rnet_ms += stats.rnet_ms;
+    timing.onet_ms += stats.onet_ms;
+    timing.faces += stats.onet_boxes;
+}
+
+static float iou(const Bbox &a, const Bbox &b) {
+    float w = min(a.x2, b.x2) - max(a.x1, b.x1);
+    float h = min(a.y2, b.y2) - max(a.y1, b.y1);
+    if (w <= 0 || h <= 0)
+        return 0;
+    float inter = w * h;
+    return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+static void print(const char *name, const BackendTiming &timing, int frames) {
+    cout << name << "pyramid: " << timing.pyramid_ms / frames << " ms, pnet: " << timing.pnet_ms / frames
+         << " ms, rnet: " << timing.rnet_ms / frames << " ms, onet: " << timing.onet_ms / frames << " ms, faces: " << timing.faces << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cout << "usage: bench_backends <ncnn_model_path> <caffe_model_path> <transpose 0|1> <image> [image ...]" << std::endl;
+        return 1;
+    }
+
+    vector<cv::Mat> frames;
+    for (int i = 4; i < argc; i++) {
+        cv::Mat frame = cv::imread(argv[i], CV_LOAD_IMAGE_COLOR);
+        if (frame.empty()) {
+            std::cerr << "cv::Imread failed. File Path: " << argv[i] << std::endl;
+            return 1;
+        }
+        frames.push_back(frame);
+    }
+
+    MTCNNOptions options;
+    options.batch_stages = true;
+    MTCNN ncnn_mm(argv[1], options);
+    options.backend = BACKEND_OPENCV_DNN;
+    options.transpose_input = atoi(argv[3]) != 0;
+    MTCNN dnn_mm(argv[2], options);
+
+    // warm up
+    vector<Bbox> expected, actual;
+    ncnn_mm.detect(frames[0], expected);
+    dnn_mm.detect(frames[0], actual);
+
+    BackendTiming ncnn_timing = BackendTiming(), dnn_timing = BackendTiming();
+    int matched = 0;
+    float matched_iou = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        detect(ncnn_mm, frames[f], expected, ncnn_timing);
+        detect(dnn_mm, frames[f], actual, dnn_timing);
+
+        // best overlapping dnn face of every ncnn face
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (!expected[i].exist)
+                continue;
+            float best = 0;
+            for (size_t j = 0; j < actual.size(); j++) {
+                if (actual[j].exist)
+                    best = max(best, iou(expected[i], actual[j]));
+            }
+            if (best >= 0.5) {
+                matched++;
+                matched_iou += best;
+            }
+        }
+    }
+
+    int n = frames.size();
+    print("ncnn        ", ncnn_timing, n);
+    print("opencv dnn  ", dnn_timing, n);
+    cout << "matched faces: " << matched << " of " << ncnn_timing.faces << ", mean IOU: "
+         << (matched ? matched_iou / matched : 0) << endl;
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <thread>
+#include "detection_service.h"
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * N camera threads detecting the same image: one detector per camera against
+ * one DetectionService for all of them
+ */
+static void bench(shared_ptr<const MTCNNModel> model, const cv::Mat &image, int cameras, int threads, int iterations, bool service) {
+    MTCNNOptions options;
+    options.num_threads = threads;
+    options.batch_stages = true;
+    shared_ptr<DetectionService> detection_service;
+    if (service)
+        detection_service = make_shared<DetectionService>(model, options, cameras);
+
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    vector<thread> workers;
+    for (int c = 0; c < cameras; c++) {
+        workers.push_back(thread([&]() {
+            MTCNN mm(model, options);
+            for (int i = 0; i < iterations; i++) {
+                vector<Bbox> finalBbox;
+                if (service)
+                    finalBbox = detection_service->submit(image).get();
+                else
+                    mm.detect(image, finalBbox);
+            }
+        }));
+    }
+    for (size_t c = 0; c < workers.size(); c++)
+        workers[c].join();
+    gettimeofday(&tv2, NULL);
+
+    float total_ms = getElapse(&tv1, &tv2);
+    cout << (service ? "service   " : "detectors ") << cameras << " cameras: " << total_ms / iterations
+         << " ms per round, " << cameras * iterations * 1000.0 / total_ms << " frames/s";
+    if (service) {
+        DetectionServiceStats stats = detection_service->stats();
+        cout << ", batch size: " << (float)stats.requests / stats.batches << " avg, " << stats.max_batch
+             << " max, queue wait: " << stats.queue_wait_ms / stats.requests << " ms avg, " << stats.max_wait_ms << " ms max";
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: bench_detection_service <model_path> <image> [cameras] [threads] [iterations]" << std::endl;
+        return 1;
+    }
+
+    int cameras = argc > 3 ? atoi(argv[3]) : 4;
+    int threads = argc > 4 ? atoi(argv[4]) : 4;
+    int iterations = argc > 5 ? atoi(argv[5]) : 20;
+    cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+    if (image.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << argv[2] << std::endl;
+        return 1;
+    }
+    shared_ptr<const MTCNNModel> model = MTCNNModel::load(argv[1]);
+    if (!model)
+        return 1;
+
+    // each camera detector on threads / cameras cores, the service on all of them
+    bench(model, image, cameras, max(1, threads / cameras), iterations, false);
+    bench(model, image, cameras, threads, iterations, true);
+    return 0;
+}
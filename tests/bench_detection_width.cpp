@@ -0,0 +1,95 @@
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * detection on the native frame against detection on a downscaled copy
+ * (DetectParams::detection_width), with and without the landmark refinement
+ */
+
+static float iou(const Bbox &a, const Bbox &b) {
+    float w = min(a.x2, b.x2) - max(a.x1, b.x1);
+    float h = min(a.y2, b.y2) - max(a.y1, b.y1);
+    if (w <= 0 || h <= 0)
+        return 0;
+    float inter = w * h;
+    return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+static float detect(MTCNN &mm, const cv::Mat &image, const DetectParams &params, int iterations, vector<Bbox> &faces) {
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    for (int i = 0; i < iterations; i++) {
+        faces.clear();
+        mm.detect(image, faces, params);
+    }
+    gettimeofday(&tv2, NULL);
+    return getElapse(&tv1, &tv2) / iterations;
+}
+
+static void compare(const vector<Bbox> &expected, const vector<Bbox> &actual) {
+    int matched = 0, count = 0;
+    float landmark_error = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (!expected[i].exist)
+            continue;
+        count++;
+        const Bbox *best = 0;
+        float best_iou = 0.5;
+        for (size_t j = 0; j < actual.size(); j++) {
+            float overlap = actual[j].exist ? iou(expected[i], actual[j]) : 0;
+            if (overlap >= best_iou) {
+                best_iou = overlap;
+                best = &actual[j];
+            }
+        }
+        if (!best)
+            continue;
+        matched++;
+        // mean landmark distance in face widths
+        float error = 0;
+        for (int k = 0; k < 5; k++)
+            error += hypot(best->ppoint[k] - expected[i].ppoint[k], best->ppoint[k + 5] - expected[i].ppoint[k + 5]);
+        landmark_error += error / 5 / max(1, expected[i].x2 - expected[i].x1);
+    }
+    cout << ", matched faces: " << matched << " of " << count << ", landmark error: "
+         << (matched ? landmark_error / matched : 0) << " face widths" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: bench_detection_width <model_path> <image> <width> [iterations]" << std::endl;
+        return 1;
+    }
+
+    cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+    if (image.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << argv[2] << std::endl;
+        return -1;
+    }
+    int width = atoi(argv[3]);
+    int iterations = argc > 4 ? atoi(argv[4]) : 10;
+
+    MTCNN mm(argv[1]);
+    vector<Bbox> native, faces;
+    DetectParams params;
+    // warm up
+    detect(mm, image, params, 1, native);
+
+    float native_ms = detect(mm, image, params, iterations, native);
+    cout << image.cols << "x" << image.rows << ": " << native_ms << " ms" << endl;
+
+    params.detection_width = width;
+    float ms = detect(mm, image, params, iterations, faces);
+    cout << "width " << width << ": " << ms << " ms (" << native_ms / ms << "x)";
+    compare(native, faces);
+
+    params.refine_landmarks = true;
+    ms = detect(mm, image, params, iterations, faces);
+    cout << "width " << width << " refined: " << ms << " ms (" << native_ms / ms << "x)";
+    compare(native, faces);
+    return 0;
+}
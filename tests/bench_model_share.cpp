@@ -0,0 +1,72 @@
+#include <iostream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * startup time and resident memory of N detectors that each read their own
+ * heap copy of the model against N detectors sharing one memory-mapped model
+ *
+ * each configuration runs in a child process so the measurements start from
+ * the same resident memory
+ */
+static void bench(const string &model_path, const cv::Mat &image, int cameras, bool shared) {
+    long rss_before = get_resident_memory_kb();
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+
+    vector<shared_ptr<MTCNN> > detectors;
+    shared_ptr<const MTCNNModel> model;
+    if (shared)
+        model = MTCNNModel::load(model_path);
+    for (int i = 0; i < cameras; i++) {
+        if (shared)
+            detectors.push_back(make_shared<MTCNN>(model));
+        else
+            detectors.push_back(make_shared<MTCNN>(MTCNNModel::load(model_path, false, false)));
+    }
+    gettimeofday(&tv2, NULL);
+    float startup_ms = getElapse(&tv1, &tv2);
+
+    // one detection per camera touches all the weights
+    for (int i = 0; i < cameras; i++) {
+        vector<Bbox> finalBbox;
+        detectors[i]->detect(image, finalBbox);
+    }
+
+    cout << (shared ? "shared  " : "private ") << cameras << " cameras, startup: " << startup_ms
+         << " ms, resident memory: +" << get_resident_memory_kb() - rss_before << " kB" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: bench_model_share <model_path> <image> [cameras]" << std::endl;
+        return 1;
+    }
+
+    std::string model_path = argv[1];
+    int cameras = argc > 3 ? atoi(argv[3]) : 8;
+    cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+    if (image.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    const int counts[] = {1, cameras};
+    for (int c = 0; c < 2; c++) {
+        for (int shared = 0; shared < 2; shared++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                bench(model_path, image, counts[c], shared);
+                return 0;
+            }
+            waitpid(pid, NULL, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sys/time.h>
+#include <vector>
+#include "nms.h"
+#include "time_utils.h"
+
+using namespace std;
+
+/*
+ * microbenchmark of NmsEngine against the previous MTCNN::nms implementation
+ * on 100 to 10k PNet-like candidates
+ */
+
+struct LegacyBox {
+    float score;
+    int x1, y1, x2, y2;
+    float area;
+    bool exist;
+};
+
+struct LegacyOrder {
+    float score;
+    int oriOrder;
+};
+
+static bool cmpScore(LegacyOrder lsh, LegacyOrder rsh) {
+    return lsh.score < rsh.score;
+}
+
+// the O(n^2) nms that used to live in MTCNN
+static void legacy_nms(vector<LegacyBox> &boundingBox_, vector<LegacyOrder> &bboxScore_, const float overlap_threshold, NmsMode mode) {
+    vector<int> heros;
+    sort(bboxScore_.begin(), bboxScore_.end(), cmpScore);
+
+    while (bboxScore_.size() > 0) {
+        int order = bboxScore_.back().oriOrder;
+        bboxScore_.pop_back();
+        if (order < 0) continue;
+        if (boundingBox_.at(order).exist == false) continue;
+        heros.push_back(order);
+        boundingBox_.at(order).exist = false;
+
+        for (int num = 0; num < boundingBox_.size(); num++) {
+            if (boundingBox_.at(num).exist) {
+                float maxX = max(boundingBox_.at(num).x1, boundingBox_.at(order).x1);
+                float maxY = max(boundingBox_.at(num).y1, boundingBox_.at(order).y1);
+                float minX = min(boundingBox_.at(num).x2, boundingBox_.at(order).x2);
+                float minY = min(boundingBox_.at(num).y2, boundingBox_.at(order).y2);
+                maxX = ((minX-maxX+1)>0)?(minX-maxX+1):0;
+                maxY = ((minY-maxY+1)>0)?(minY-maxY+1):0;
+                float IOU = maxX * maxY;
+                if (mode == NMS_UNION)
+                    IOU = IOU/(boundingBox_.at(num).area + boundingBox_.at(order).area - IOU);
+                else
+                    IOU = IOU/min(boundingBox_.at(num).area, boundingBox_.at(order).area);
+                if (IOU > overlap_threshold) {
+                    boundingBox_.at(num).exist = false;
+                    for (vector<LegacyOrder>::iterator it = bboxScore_.begin(); it != bboxScore_.end(); it++) {
+                        if ((*it).oriOrder == num) {
+                            (*it).oriOrder = -1;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (unsigned int i = 0; i < heros.size(); i++)
+        boundingBox_.at(heros.at(i)).exist = true;
+}
+
+// candidates clustered around a few faces, the way PNet fires on a 1080p frame
+static void generate(int n, vector<LegacyBox> &boxes) {
+    const int faces = 1 + n / 50;
+    vector<int> cx(faces), cy(faces), side(faces);
+    for (int f = 0; f < faces; f++) {
+        cx[f] = rand() % 1920;
+        cy[f] = rand() % 1080;
+        side[f] = 80 + rand() % 200;
+    }
+
+    boxes.resize(n);
+    for (int i = 0; i < n; i++) {
+        int f = rand() % faces;
+        int s = side[f] * (80 + rand() % 40) / 100;
+        LegacyBox &box = boxes[i];
+        box.x1 = cx[f] + rand() % (side[f] / 2 + 1) - side[f] / 4;
+        box.y1 = cy[f] + rand() % (side[f] / 2 + 1) - side[f] / 4;
+        box.x2 = box.x1 + s;
+        box.y2 = box.y1 + s;
+        box.area = (box.x2 - box.x1) * (box.y2 - box.y1);
+        box.score = 0.7f + 0.3f * rand() / RAND_MAX;
+        box.exist = true;
+    }
+}
+
+static void bench(int n, NmsMode mode, float threshold) {
+    vector<LegacyBox> boxes;
+    generate(n, boxes);
+    int repeat = max(1, 200000 / n);
+
+    struct timeval tv1, tv2;
+    vector<LegacyBox> legacy;
+    gettimeofday(&tv1, NULL);
+    for (int r = 0; r < repeat; r++) {
+        legacy = boxes;
+        vector<LegacyOrder> orders(n);
+        for (int i = 0; i < n; i++) {
+            orders[i].score = boxes[i].score;
+            orders[i].oriOrder = i;
+        }
+        legacy_nms(legacy, orders, threshold, mode);
+    }
+    gettimeofday(&tv2, NULL);
+    float legacy_ms = getElapse(&tv1, &tv2) / repeat;
+
+    NmsEngine engine;
+    BoxArray array;
+    vector<int> keep;
+    gettimeofday(&tv1, NULL);
+    for (int r = 0; r < repeat; r++) {
+        array.clear();
+        for (int i = 0; i < n; i++)
+            array.push_back(boxes[i].x1, boxes[i].y1, boxes[i].x2, boxes[i].y2, boxes[i].area, boxes[i].score);
+        engine.run(array, threshold, mode, keep);
+    }
+    gettimeofday(&tv2, NULL);
+    float engine_ms = getElapse(&tv1, &tv2) / repeat;
+
+    // both implementations must keep the same boxes
+    vector<int> expected;
+    for (int i = 0; i < n; i++) {
+        if (legacy[i].exist)
+            expected.push_back(i);
+    }
+    sort(keep.begin(), keep.end());
+
+    cout << (mode == NMS_UNION ? "Union" : "Min  ") << "  n = " << n
+         << "\tlegacy: " << legacy_ms << " ms\tengine: " << engine_ms << " ms"
+         << "\tspeedup: " << legacy_ms / engine_ms << "x\tkept: " << keep.size()
+         << (keep == expected ? "" : "  MISMATCH") << endl;
+}
+
+int main(int argc, char* argv[]) {
+    srand(2018);
+    const int sizes[] = {100, 500, 1000, 2000, 5000, 10000};
+    for (int i = 0; i < 6; i++) {
+        bench(sizes[i], NMS_UNION, 0.5);
+    }
+    for (int i = 0; i < 6; i++) {
+        bench(sizes[i], NMS_MIN, 0.7);
+    }
+}
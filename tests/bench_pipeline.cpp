@@ -0,0 +1,80 @@
+#include <deque>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "mtcnn.h"
+#include "pipelined_detector.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * replay a video file through one detector, frame after frame, and through
+ * the pipelined detector; both must find the same faces in the same order
+ */
+static bool read_frames(const string &path, int max_frames, vector<cv::Mat> &frames) {
+    cv::VideoCapture cap(path);
+    cv::Mat frame;
+    while ((int)frames.size() < max_frames && cap.read(frame))
+        frames.push_back(frame.clone());
+    return !frames.empty();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: bench_pipeline <model_path> <video> [threads per stage] [frames]" << std::endl;
+        return 1;
+    }
+
+    MTCNNOptions options;
+    options.num_threads = argc > 3 ? atoi(argv[3]) : 1;
+    options.batch_stages = true;
+    int max_frames = argc > 4 ? atoi(argv[4]) : 200;
+
+    vector<cv::Mat> frames;
+    if (!read_frames(argv[2], max_frames, frames)) {
+        std::cerr << "failed to read video: " << argv[2] << std::endl;
+        return -1;
+    }
+    std::shared_ptr<const MTCNNModel> model = MTCNNModel::load(argv[1]);
+    if (!model)
+        return -1;
+
+    struct timeval tv1, tv2;
+    MTCNN mm(model, options);
+    vector<int> expected;
+    gettimeofday(&tv1, NULL);
+    for (size_t i = 0; i < frames.size(); i++) {
+        vector<Bbox> faces;
+        mm.detect(frames[i], faces);
+        expected.push_back(faces.size());
+    }
+    gettimeofday(&tv2, NULL);
+    float serial_ms = getElapse(&tv1, &tv2);
+    cout << frames.size() << " frames, one detector: " << frames.size() * 1000 / serial_ms << " fps" << endl;
+
+    PipelinedDetector pipeline(model, options);
+    deque<future<vector<Bbox> > > pending;
+    bool same = true;
+    size_t done = 0;
+    gettimeofday(&tv1, NULL);
+    for (size_t i = 0; i < frames.size(); i++) {
+        pending.push_back(pipeline.submit(frames[i]));
+        // collect what is ready so the futures do not pile up
+        while (!pending.empty() && pending.front().wait_for(chrono::seconds(0)) == future_status::ready) {
+            same = same && (int)pending.front().get().size() == expected[done++];
+            pending.pop_front();
+        }
+    }
+    while (!pending.empty()) {
+        same = same && (int)pending.front().get().size() == expected[done++];
+        pending.pop_front();
+    }
+    gettimeofday(&tv2, NULL);
+    float pipeline_ms = getElapse(&tv1, &tv2);
+
+    PipelineStats stats = pipeline.stats();
+    cout << "pipelined: " << frames.size() * 1000 / pipeline_ms << " fps (" << serial_ms / pipeline_ms << "x), stage occupancy pnet: "
+         << stats.occupancy(0) << ", rnet: " << stats.occupancy(1) << ", onet: " << stats.occupancy(2)
+         << (same ? "" : "  FACE MISMATCH") << endl;
+    return 0;
+}
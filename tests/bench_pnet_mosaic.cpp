@@ -0,0 +1,56 @@
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * compare PNet over a mosaic of all scales with the per scale PNet
+ */
+static void bench(MTCNN &mm, const cv::Mat &cv_img, bool mosaic, int iterations) {
+    mm.setPNetMosaic(mosaic);
+
+    float pnet_ms = 0, total_ms = 0;
+    int faces = 0;
+    struct timeval  tv1,tv2;
+    for (int i = 0; i < iterations; i++) {
+        std::vector<Bbox> finalBbox;
+        ncnn::Mat ncnn_img = ncnn::Mat::from_pixels(cv_img.data, ncnn::Mat::PIXEL_BGR2RGB, cv_img.cols, cv_img.rows);
+        gettimeofday(&tv1, NULL);
+        mm.detect(ncnn_img, finalBbox);
+        gettimeofday(&tv2, NULL);
+
+        total_ms += getElapse(&tv1, &tv2);
+        pnet_ms += mm.stats().pnet_ms;
+        faces = mm.stats().onet_boxes;
+    }
+
+    cout << (mosaic ? "mosaic    " : "per scale ") << "pnet: " << pnet_ms / iterations << " ms, detect: "
+         << total_ms / iterations << " ms, pnet candidates: " << mm.stats().pnet_boxes << ", faces: " << faces << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: bench_pnet_mosaic <model_path> <image> [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::string model_path = argv[1];
+    std::string imagepath = argv[2];
+    int iterations = argc > 3 ? atoi(argv[3]) : 20;
+
+    cv::Mat cv_img = cv::imread(imagepath, CV_LOAD_IMAGE_COLOR);
+    if (cv_img.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << imagepath << std::endl;
+        return -1;
+    }
+
+    MTCNN mm(model_path);
+    // warm up
+    bench(mm, cv_img, false, 1);
+
+    bench(mm, cv_img, false, iterations);
+    bench(mm, cv_img, true, iterations);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "mtcnn.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ * PNet on whole pyramid levels against tiled PNet for 1 .. max_threads cores,
+ * both must find the same candidates
+ */
+static float bench(const string &model_path, const cv::Mat &image, int threads, int tile, int iterations, int &candidates) {
+    MTCNNOptions options;
+    options.num_threads = threads;
+    options.pnet_tile_size = tile;
+    options.batch_stages = true;
+    MTCNN mm(model_path, options);
+
+    vector<Bbox> faces;
+    // warm up
+    mm.detect(image, faces);
+    float pnet_ms = 0;
+    for (int i = 0; i < iterations; i++) {
+        faces.clear();
+        mm.detect(image, faces);
+        pnet_ms += mm.stats().pnet_ms;
+    }
+    candidates = mm.stats().pnet_boxes;
+    return pnet_ms / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: bench_pnet_tiles <model_path> <image> <max_threads> [tile_size] [iterations]" << std::endl;
+        return 1;
+    }
+
+    cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+    if (image.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << argv[2] << std::endl;
+        return -1;
+    }
+    int max_threads = atoi(argv[3]);
+    int tile = argc > 4 ? atoi(argv[4]) : 128;
+    int iterations = argc > 5 ? atoi(argv[5]) : 10;
+
+    cout << image.cols << "x" << image.rows << ", tile size " << tile << endl;
+    int expected = 0;
+    float single_ms = bench(argv[1], image, 1, 0, iterations, expected);
+    cout << "1 thread: pnet " << single_ms << " ms, " << expected << " candidates" << endl;
+    for (int threads = 2; threads <= max_threads; threads++) {
+        int whole_candidates = 0, tiled_candidates = 0;
+        float whole_ms = bench(argv[1], image, threads, 0, iterations, whole_candidates);
+        float tiled_ms = bench(argv[1], image, threads, tile, iterations, tiled_candidates);
+        cout << threads << " threads: whole levels " << whole_ms << " ms (" << single_ms / whole_ms << "x), tiles "
+             << tiled_ms << " ms (" << single_ms / tiled_ms << "x)"
+             << (whole_candidates == expected && tiled_candidates == expected ? "" : "  CANDIDATE MISMATCH") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "async_detector.h"
+#include "mtcnn.h"
+
+using namespace std;
+
+/*
+ * the DetectParams handed to AsyncDetector::submit must reach the detector
+ * whole, not only its regions
+ */
+static vector<Bbox> detect(AsyncDetector &async_detector, const cv::Mat &image, const DetectParams &params) {
+    return async_detector.submit(image, params).get();
+}
+
+static int count_faces(const vector<Bbox> &faces) {
+    int count = 0;
+    for (size_t i = 0; i < faces.size(); i++)
+        count += faces[i].exist;
+    return count;
+}
+
+// an exclusion polygon over the whole frame leaves no face
+static bool test_exclusions(AsyncDetector &async_detector, const cv::Mat &image) {
+    vector<vector<cv::Point> > polygons(1);
+    polygons[0].push_back(cv::Point(0, 0));
+    polygons[0].push_back(cv::Point(image.cols, 0));
+    polygons[0].push_back(cv::Point(image.cols, image.rows));
+    polygons[0].push_back(cv::Point(0, image.rows));
+    DetectParams params;
+    params.exclusions = make_shared<ExclusionMask>(polygons);
+
+    int faces = count_faces(detect(async_detector, image, params));
+    long dropped = params.exclusions->counts()[0];
+    cout << "exclusions: " << faces << " faces, " << dropped << " candidates dropped" << endl;
+    return faces == 0 && dropped > 0;
+}
+
+// a band over the whole frame that expects no face size leaves PNet nothing to scan
+static bool test_size_bands(AsyncDetector &async_detector, MTCNN &mm, const cv::Mat &image) {
+    DetectParams params;
+    FaceSizeBand band = {0, image.rows, 0, 0};
+    params.size_bands.push_back(band);
+
+    int faces = count_faces(detect(async_detector, image, params));
+    cout << "size bands: " << faces << " faces, " << mm.stats().pnet_area * 100 << "% of the pyramid scanned" << endl;
+    return faces == 0 && mm.stats().pnet_area == 0;
+}
+
+// a scale history submitted with the frame is consulted and counts the faces
+static bool test_scale_history(AsyncDetector &async_detector, const cv::Mat &image) {
+    DetectParams params;
+    params.scale_history = make_shared<ScaleHistory>(10, 10);
+
+    int faces = count_faces(detect(async_detector, image, params));
+    ScaleHistoryStats stats = params.scale_history->stats();
+    long recorded = 0;
+    for (size_t i = 0; i < stats.faces.size(); i++)
+        recorded += stats.faces[i];
+    cout << "scale history: " << stats.detections << " detections, " << recorded << " of " << faces << " faces recorded" << endl;
+    return stats.detections == 1 && recorded == faces;
+}
+
+// downscaled below the smallest face size (80 pixels) nothing can be found
+static bool test_detection_width(AsyncDetector &async_detector, const cv::Mat &image) {
+    DetectParams params;
+    params.detection_width = 40;
+
+    int faces = count_faces(detect(async_detector, image, params));
+    cout << "detection width " << params.detection_width << ": " << faces << " faces" << endl;
+    return faces == 0;
+}
+
+// a deadline no detection can meet stops PNet after the first scale
+static bool test_deadline(AsyncDetector &async_detector, MTCNN &mm, const cv::Mat &image) {
+    DetectParams params;
+    params.deadline_ms = 0.001f;
+
+    detect(async_detector, image, params);
+    const DetectStats &stats = mm.stats();
+    cout << "deadline " << params.deadline_ms << " ms: " << (stats.deadline_hit ? "hit" : "not hit") << ", "
+         << stats.completeness * 100 << "% done" << endl;
+    return stats.deadline_hit && stats.completeness < 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cout << "usage: test_async_params <model_path> <image>" << std::endl;
+        return 1;
+    }
+
+    cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+    if (image.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    MTCNN mm(argv[1]);
+    AsyncDetector async_detector(mm);
+    int faces = count_faces(detect(async_detector, image, DetectParams()));
+    cout << "default params: " << faces << " faces" << endl;
+    if (faces == 0) {
+        cout << "the image needs a face" << endl;
+        return 1;
+    }
+
+    bool ok = true;
+    ok = test_exclusions(async_detector, image) && ok;
+    ok = test_size_bands(async_detector, mm, image) && ok;
+    ok = test_scale_history(async_detector, image) && ok;
+    ok = test_detection_width(async_detector, image) && ok;
+    ok = test_deadline(async_detector, mm, image) && ok;
+
+    cout << (ok ? "PASS" : "FAIL") << endl;
+    return ok ? 0 : 1;
+}
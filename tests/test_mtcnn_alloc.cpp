@@ -0,0 +1,56 @@
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "mtcnn.h"
+
+using namespace std;
+
+/*
+ * steady state detection must not take new ncnn blob or workspace buffers
+ * from the heap: after a few warm up frames the pool counter of MTCNN stays
+ * constant. Other per frame allocations (the params copy, the nms sort
+ * buffer, cv::findContours, the scale history statistics, the result
+ * vector) are not counted.
+ */
+static bool test_steady_state(MTCNN &mm, const cv::Mat &image, int warmup, int iterations) {
+    std::vector<Bbox> finalBbox;
+    for (int i = 0; i < warmup; i++) {
+        finalBbox.clear();
+        mm.detect(image, finalBbox);
+    }
+
+    size_t allocations = mm.heapAllocations();
+    for (int i = 0; i < iterations; i++) {
+        finalBbox.clear();
+        mm.detect(image, finalBbox);
+    }
+
+    cout << "pool heap allocations after warm up: " << allocations << ", after "
+         << iterations << " more frames: " << mm.heapAllocations() << endl;
+    return mm.heapAllocations() == allocations;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cout << "usage: test_mtcnn_alloc <model_path> <image>" << std::endl;
+        return 1;
+    }
+
+    cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+    if (image.empty()) {
+        std::cerr << "cv::Imread failed. File Path: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    MTCNN mm(argv[1]);
+
+    bool ok = true;
+    mm.setBatchStages(false);
+    ok = test_steady_state(mm, image, 5, 20) && ok;
+    mm.setBatchStages(true);
+    ok = test_steady_state(mm, image, 5, 20) && ok;
+    mm.setPNetMosaic(true);
+    ok = test_steady_state(mm, image, 5, 20) && ok;
+
+    cout << (ok ? "PASS" : "FAIL") << endl;
+    return ok ? 0 : 1;
+}